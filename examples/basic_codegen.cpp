@@ -102,5 +102,18 @@ int main(int argc, char *argv[]) {
   gen.jacobian(input, jacobian);
   print(jacobian);
 
+  // starts on the CppAD tape and compiles the function once it is hot
+  gen.set_mode(autogen::GENERATE_AUTO);
+  gen.set_auto_compile_threshold(10, 1.0);
+  std::cout << "### Mode: " << gen.mode() << std::endl;
+  for (int i = 0; i < 20; ++i) {
+    gen(input, output);
+  }
+  autogen::TierRegistry::global().print(std::cout);
+  gen.compile_async(input).wait();
+  gen(input, output);
+  print(output);
+  autogen::TierRegistry::global().print(std::cout);
+
   return EXIT_SUCCESS;
 }
\ No newline at end of file
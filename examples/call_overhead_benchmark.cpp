@@ -0,0 +1,79 @@
+#include <iostream>
+
+#include "autogen/autogen.hpp"
+#include "autogen/generated_fixed.hpp"
+#include "autogen/utils/stopwatch.hpp"
+
+/**
+ * Measures the per-call overhead of single-sample evaluations of a tiny
+ * compiled function through the `GenericModel` interface of CppADCodeGen
+ * versus the direct function-pointer fast path, and through the
+ * fixed-dimension front end `GeneratedFixed` with `std::array` buffers.
+ */
+
+const int kNumCalls = 1 << 22;
+
+template <typename Scalar>
+void tiny_function(const std::vector<Scalar> &input,
+                   std::vector<Scalar> &output) {
+  using std::sin;
+  output[0] = input[0] * input[1] + sin(input[0]);
+}
+
+template <typename Scalar>
+struct TinyFunctor {
+  void operator()(const std::vector<Scalar> &input,
+                  std::vector<Scalar> &output) const {
+    tiny_function(input, output);
+  }
+};
+
+template <typename Fun>
+double ns_per_call(Fun fun) {
+  autogen::Stopwatch timer;
+  // warm up
+  for (int i = 0; i < 1000; ++i) {
+    fun();
+  }
+  timer.start();
+  for (int i = 0; i < kNumCalls; ++i) {
+    fun();
+  }
+  timer.stop();
+  return timer.elapsed() / kNumCalls * 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  using namespace autogen;
+  using ADCGScalar = typename CppAD::AD<CppAD::cg::CG<BaseScalar>>;
+
+  std::vector<double> input = {0.3, -1.2}, output(1), jac(2);
+  auto functor = [](const std::vector<ADCGScalar> &x,
+                    std::vector<ADCGScalar> &y) { tiny_function(x, y); };
+
+  FunctionTrace<BaseScalar> trace =
+      autogen::trace(functor, "call_overhead_bench", input, output);
+  GeneratedCodeGen gen(trace);
+  gen.compile_cpu();
+
+  for (bool fast_path : {false, true}) {
+    gen.call_function_pointers = fast_path;
+    const char *label = fast_path ? "function pointer" : "GenericModel";
+    double t_forward = ns_per_call([&]() { gen(input, output); });
+    double t_jacobian = ns_per_call([&]() { gen.jacobian(input, jac); });
+    std::cout << "Forward  (" << label << "): " << t_forward << " ns/call\n";
+    std::cout << "Jacobian (" << label << "): " << t_jacobian << " ns/call\n";
+  }
+
+  GeneratedFixed<TinyFunctor, 2, 1> fixed("call_overhead_bench_fixed");
+  fixed.set_mode(GENERATE_CPU);
+  std::array<double, 2> fixed_input = {0.3, -1.2}, fixed_jac;
+  std::array<double, 1> fixed_output;
+  double t_forward = ns_per_call([&]() { fixed(fixed_input, fixed_output); });
+  double t_jacobian =
+      ns_per_call([&]() { fixed.jacobian(fixed_input, fixed_jac); });
+  std::cout << "Forward  (std::array): " << t_forward << " ns/call\n";
+  std::cout << "Jacobian (std::array): " << t_jacobian << " ns/call\n";
+
+  return EXIT_SUCCESS;
+}
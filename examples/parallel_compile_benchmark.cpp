@@ -0,0 +1,95 @@
+#include <cmath>
+#include <iostream>
+
+#include "autogen/autogen.hpp"
+#include "autogen/utils/stopwatch.hpp"
+
+/**
+ * Compares the wall-clock time of compiling a large synthetic model (a deep
+ * network of dense layers, each of which is an atomic function) one
+ * translation unit at a time versus concurrently with one job per hardware
+ * thread.
+ */
+
+const int kWidth = 48;
+const int kNumLayers = 8;
+const int kNumSteps = 4;
+
+template <typename Scalar>
+void dense_layer(int layer, const std::vector<Scalar> &input,
+                 std::vector<Scalar> &output) {
+  using std::tanh;
+  for (int i = 0; i < kWidth; ++i) {
+    Scalar sum = 0.0;
+    for (int j = 0; j < kWidth; ++j) {
+      const double weight = std::sin(1.0 + layer * kWidth * kWidth +
+                                     i * kWidth + j);
+      sum += weight * input[j];
+    }
+    output[i] = tanh(sum);
+  }
+}
+
+template <typename Scalar>
+void network(const std::vector<Scalar> &input, std::vector<Scalar> &output) {
+  std::vector<Scalar> state = input, next(kWidth);
+  for (int step = 0; step < kNumSteps; ++step) {
+    for (int layer = 0; layer < kNumLayers; ++layer) {
+      std::function<void(const std::vector<Scalar> &, std::vector<Scalar> &)>
+          functor = [layer](const std::vector<Scalar> &x,
+                            std::vector<Scalar> &y) {
+            dense_layer(layer, x, y);
+          };
+      autogen::call_atomic("layer_" + std::to_string(layer), functor, state,
+                           next);
+      // residual connection in the main model
+      for (int i = 0; i < kWidth; ++i) {
+        state[i] = state[i] + next[i] * state[(i + 1) % kWidth];
+      }
+    }
+  }
+  output = state;
+}
+
+int main(int argc, char *argv[]) {
+  using namespace autogen;
+  using ADCGScalar = typename CppAD::AD<CppAD::cg::CG<BaseScalar>>;
+
+  std::vector<double> input(kWidth), output(kWidth);
+  for (int i = 0; i < kWidth; ++i) {
+    input[i] = std::cos(0.1 * i);
+  }
+  auto functor = [](const std::vector<ADCGScalar> &x,
+                    std::vector<ADCGScalar> &y) { network(x, y); };
+
+  Stopwatch timer;
+  double serial_time = 0.0;
+  for (int num_jobs : {1, 0}) {
+    const std::string name =
+        num_jobs == 1 ? "compile_bench_serial" : "compile_bench_parallel";
+    FunctionTrace<BaseScalar> trace =
+        autogen::trace(functor, name, input, output);
+    GeneratedCodeGen gen(trace);
+    gen.num_compile_jobs = num_jobs;
+    gen.max_assignments_per_function = 2000;
+    // always compile all translation units
+    gen.cache_directory = "";
+    gen.incremental_compilation = false;
+    timer.start();
+    gen.compile_cpu();
+    timer.stop();
+
+    std::vector<double> result(kWidth);
+    gen(input, result);
+    if (num_jobs == 1) {
+      serial_time = timer.elapsed();
+      std::cout << "Serial compilation:   " << serial_time << " s\n";
+    } else {
+      std::cout << "Parallel compilation: " << timer.elapsed() << " s ("
+                << serial_time / timer.elapsed() << "x speedup with "
+                << std::thread::hardware_concurrency() << " threads)\n";
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <random>
+
+#include "autogen/autogen.hpp"
+#include "autogen/utils/stopwatch.hpp"
+
+/**
+ * Compares the SIMD-across-samples functions (structure-of-arrays layout) at
+ * different block widths against the scalar per-sample path.
+ */
+
+const int kNumSamples = 1 << 16;
+const int kNumRepetitions = 20;
+const int kInputDim = 16;
+
+template <typename Scalar>
+void kinematic_chain(const std::vector<Scalar> &input,
+                     std::vector<Scalar> &output) {
+  using std::sin, std::cos;
+  // planar chain with alternating joint angles and link lengths
+  Scalar x = 0.0, y = 0.0, angle = 0.0;
+  for (int i = 0; i < kInputDim; i += 2) {
+    angle += input[i];
+    x += input[i + 1] * cos(angle);
+    y += input[i + 1] * sin(angle);
+  }
+  output[0] = x;
+  output[1] = y;
+  output[2] = x * x + y * y;
+}
+
+int main(int argc, char *argv[]) {
+  using namespace autogen;
+  using ADCGScalar = typename CppAD::AD<CppAD::cg::CG<BaseScalar>>;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<double> inputs(kNumSamples * kInputDim);
+  for (double &v : inputs) {
+    v = dist(rng);
+  }
+
+  std::vector<double> input(inputs.begin(), inputs.begin() + kInputDim),
+      output(3);
+  auto functor = [](const std::vector<ADCGScalar> &x,
+                    std::vector<ADCGScalar> &y) { kinematic_chain(x, y); };
+
+  Stopwatch timer;
+
+  // scalar per-sample path via the batch kernel
+  {
+    FunctionTrace<BaseScalar> trace =
+        autogen::trace(functor, "simd_bench_scalar", input, output);
+    GeneratedCodeGen gen(trace);
+    gen.compile_cpu();
+    std::vector<double> outputs(kNumSamples * gen.output_dim());
+    gen(kNumSamples, {inputs.data(), kInputDim},
+        {outputs.data(), gen.output_dim()});
+    timer.start();
+    for (int r = 0; r < kNumRepetitions; ++r) {
+      gen(kNumSamples, {inputs.data(), kInputDim},
+          {outputs.data(), gen.output_dim()});
+    }
+    timer.stop();
+    std::cout << "Scalar per-sample:  "
+              << timer.elapsed() / kNumRepetitions / kNumSamples * 1e9
+              << " ns/sample\n";
+  }
+
+  for (int width : {4, 8, 16}) {
+    FunctionTrace<BaseScalar> trace = autogen::trace(
+        functor, "simd_bench_w" + std::to_string(width), input, output);
+    GeneratedCodeGen gen(trace);
+    gen.simd_width = width;
+    gen.generate_batch = false;
+    gen.compile_cpu();
+
+    const int num_blocks = soa_num_blocks(kNumSamples, width);
+    std::vector<double> soa_inputs(num_blocks * width * kInputDim);
+    std::vector<double> soa_outputs(num_blocks * width * gen.output_dim());
+    std::vector<double> outputs(kNumSamples * gen.output_dim());
+    aos_to_soa<double>(kNumSamples, kInputDim, width,
+                       {inputs.data(), kInputDim}, soa_inputs.data());
+    gen.forward_zero_soa(num_blocks, soa_inputs.data(), soa_outputs.data());
+
+    timer.start();
+    for (int r = 0; r < kNumRepetitions; ++r) {
+      gen.forward_zero_soa(num_blocks, soa_inputs.data(), soa_outputs.data());
+    }
+    timer.stop();
+    std::cout << "SIMD width " << width << ":       "
+              << timer.elapsed() / kNumRepetitions / kNumSamples * 1e9
+              << " ns/sample\n";
+
+    // including the transposition from and to AoS
+    timer.start();
+    for (int r = 0; r < kNumRepetitions; ++r) {
+      aos_to_soa<double>(kNumSamples, kInputDim, width,
+                         {inputs.data(), kInputDim}, soa_inputs.data());
+      gen.forward_zero_soa(num_blocks, soa_inputs.data(), soa_outputs.data());
+      soa_to_aos<double>(kNumSamples, gen.output_dim(), width,
+                         soa_outputs.data(),
+                         {outputs.data(), gen.output_dim()});
+    }
+    timer.stop();
+    std::cout << "SIMD width " << width << " (AoS): "
+              << timer.elapsed() / kNumRepetitions / kNumSamples * 1e9
+              << " ns/sample\n";
+  }
+
+  return EXIT_SUCCESS;
+}
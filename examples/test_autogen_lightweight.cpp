@@ -1,12 +1,16 @@
-#include <cppad/cg.hpp>
-#include <cppad/cg/arithmetic.hpp>
+#include <iostream>
 
 #include "autogen/autogen_lightweight.hpp"
 
-namespace {
-using CGScalar = typename CppAD::cg::CG<double>;
-using ADFun = typename CppAD::ADFun<CGScalar>;
+/**
+ * Loads a CPU library that has been compiled beforehand and evaluates it
+ * without CppAD or CppADCodeGen. By default, the library of the function
+ * "simple_a" that is written by the `basic_codegen` example is used;
+ * otherwise the function name and optionally the library basename (without
+ * extension) are given as arguments.
+ */
 
+namespace {
 void print(const std::vector<double>& vs) {
   for (std::size_t i = 0; i < vs.size(); ++i) {
     std::cout << vs[i];
@@ -14,35 +18,20 @@ void print(const std::vector<double>& vs) {
   }
   std::cout << std::endl;
 }
-
-template <typename BaseScalar>
-void test_function(const std::vector<BaseScalar>& input,
-                   std::vector<BaseScalar>& output) {
-  output.clear();
-  output.resize(input.size());
-  for (size_t i = 0; i < input.size(); i++) {
-    output[i] = input[i] * 2.0;
-  }
-}
 }  // namespace
 
 int main(int argc, char* argv[]) {
-  std::vector<double> input = {1.0, 2.0};
-  std::vector<CppAD::AD<CGScalar>> ax(input.size()), ay(input.size());
-  for (size_t i = 0; i < input.size(); ++i) {
-    ax[i] = CGScalar(input[i]);
+  const std::string name = argc > 1 ? argv[1] : "simple_a";
+  const std::string library = argc > 2 ? argv[2] : "";
+  autogen::GeneratedLightWeight<double> gen(name, library);
+  std::cout << "Loaded \"" << name << "\" with " << gen.input_dim()
+            << " inputs and " << gen.output_dim() << " outputs.\n";
+
+  std::vector<double> test_input(gen.input_dim()), test_output;
+  for (int i = 0; i < gen.input_dim(); ++i) {
+    test_input[i] = 0.1 * (i + 1);
   }
-  CppAD::Independent(ax);
-  test_function<CppAD::AD<CGScalar>>(ax, ay);
-  std::shared_ptr<ADFun> fun = std::make_shared<ADFun>(ax, ay);
-//  ADFun fun(ax, ay);
-  autogen::GeneratedLightWeight<double> gen("test", fun);
-
   std::vector<double> test_jacobian;
-  std::vector<double> test_input = {1.0, 2.0};
-  std::vector<double> test_output(2);
-
-//  print(fun->Forward(0, test_input));
 
   gen(test_input, test_output);
   print(test_output);
@@ -50,5 +39,17 @@ int main(int argc, char* argv[]) {
   gen.jacobian(test_input, test_jacobian);
   print(test_jacobian);
 
+  // vectorized evaluation of the local inputs of several samples
+  const int num_samples = 4;
+  std::vector<std::vector<double>> local_inputs(
+      num_samples, std::vector<double>(test_input.begin() +
+                                           gen.global_input_dim(),
+                                       test_input.end())),
+      outputs;
+  std::vector<double> global_input(
+      test_input.begin(), test_input.begin() + gen.global_input_dim());
+  gen(local_inputs, outputs, global_input);
+  print(outputs.back());
+
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <mutex>
 
 // clang-format off
 #include "utils/system.hpp"
+#include "utils/tier_telemetry.hpp"
 #include "core/codegen.hpp"
 #include "core/base.hpp"
 #include "core/generated_numerical.hpp"
@@ -16,7 +20,14 @@ enum GenerationMode {
   GENERATE_NONE,
   GENERATE_CPPAD,
   GENERATE_CPU,
-  GENERATE_CUDA
+  GENERATE_CUDA,
+  // evaluates the CppAD tape until the function becomes hot, and then
+  // compiles it for the CPU in the background
+  // (see `Generated::set_auto_compile_threshold()`)
+  GENERATE_AUTO,
+  // compiles the CPU code in memory via the LLVM JIT (requires
+  // AUTOGEN_USE_LLVM, see `GeneratedCodeGen::compile_jit()`)
+  GENERATE_JIT
 };
 
 static inline std::string str(const GenerationMode& mode) {
@@ -29,6 +40,10 @@ static inline std::string str(const GenerationMode& mode) {
       return "CPU";
     case GENERATE_CUDA:
       return "CUDA";
+    case GENERATE_AUTO:
+      return "Auto";
+    case GENERATE_JIT:
+      return "JIT";
   }
   return "Unknown";
 }
@@ -39,7 +54,12 @@ static inline std::ostream& operator<<(std::ostream& os,
   return os;
 }
 
-template <template <typename> typename Functor>
+/**
+ * Function that is evaluated numerically, via CppAD or via generated code
+ * depending on its `mode()`. All evaluations operate on `BaseScalar`, which
+ * is also the scalar type the function is traced and compiled in.
+ */
+template <template <typename> typename Functor, typename BaseScalar = double>
 struct Generated {
   static inline std::map<std::string, FunctionTrace<BaseScalar>> traces;
 
@@ -50,17 +70,36 @@ struct Generated {
   using ADCGScalar = typename CppAD::AD<CGScalar>;
   using ADFun = typename FunctionTrace<BaseScalar>::ADFun;
 
+  /**
+   * Whether the first evaluation in CPU or CUDA mode starts the compilation
+   * in the background (see `compile_async()`) instead of blocking until the
+   * compiled library is ready.
+   */
   bool compile_in_background{false};
-  bool is_compiling_{false};
 
  protected:
   std::unique_ptr<Functor<BaseScalar>> f_double_{nullptr};
   std::unique_ptr<Functor<ADScalar>> f_cppad_{nullptr};
   std::unique_ptr<Functor<ADCGScalar>> f_cg_{nullptr};
 
-  std::unique_ptr<GeneratedNumerical> gen_double_{nullptr};
-  std::unique_ptr<GeneratedCppAD> gen_cppad_{nullptr};
-  std::unique_ptr<GeneratedCodeGen> gen_cg_{nullptr};
+  std::unique_ptr<GeneratedNumericalT<BaseScalar>> gen_double_{nullptr};
+  std::unique_ptr<GeneratedCppADT<BaseScalar>> gen_cppad_{nullptr};
+  std::unique_ptr<GeneratedCodeGenT<BaseScalar>> gen_cg_{nullptr};
+
+  // CppAD tape that serves the evaluations while gen_cg_ is being compiled
+  std::unique_ptr<GeneratedCppADT<BaseScalar>> gen_fallback_{nullptr};
+  // evaluations of the fallback tape cannot run concurrently
+  std::mutex fallback_mutex_;
+  // set until the background compilation has succeeded
+  std::atomic<bool> use_fallback_{false};
+  std::shared_future<void> compilation_;
+
+  // input on which the function is traced when it gets compiled in
+  // GENERATE_AUTO mode
+  std::vector<BaseScalar> auto_compile_input_;
+  std::uint64_t auto_compile_calls_{1000};
+  double auto_compile_seconds_{1.0};
+  std::shared_ptr<TierCounters> tier_counters_{nullptr};
 
   int local_input_dim_{0};
   int global_input_dim_{0};
@@ -69,18 +108,31 @@ struct Generated {
   bool debug_mode_{false};
 
   GenerationMode mode_{GENERATE_CPU};
-  mutable std::mutex compilation_mutex_;
+
+  std::shared_ptr<ThreadPool> thread_pool_{nullptr};
+  int batch_chunk_size_{0};
+
+  std::string cache_directory_{CompilationCache::directory_from_environment()};
+  bool generate_hessian_{false};
+  bool generate_directional_derivatives_{false};
+  AccumulationMethod jac_acc_method_{ACCUMULATE_NONE};
+  bool compensated_summation_{false};
+  bool optimize_tapes_{false};
+  TapeOptimizationOptions tape_optimization_;
 
  public:
   template <typename... Args>
   Generated(const std::string& name, Args&&... args) : name(name) {
     f_double_ =
         std::make_unique<Functor<BaseScalar>>(std::forward<Args>(args)...);
-    gen_double_ = std::make_unique<GeneratedNumerical>(*f_double_);
+    gen_double_ =
+        std::make_unique<GeneratedNumericalT<BaseScalar>>(*f_double_);
     f_cppad_ = std::make_unique<Functor<ADScalar>>(std::forward<Args>(args)...);
     f_cg_ = std::make_unique<Functor<ADCGScalar>>(std::forward<Args>(args)...);
   }
 
+  virtual ~Generated() { wait_for_compilation_(); }
+
   GenerationMode mode() const { return mode_; }
   void set_mode(GenerationMode mode) {
     if (mode != this->mode_) {
@@ -93,15 +145,46 @@ struct Generated {
       }
     }
     this->mode_ = mode;
+    if (mode_ != GENERATE_AUTO) {
+      tier_counters_.reset();
+    } else if (!tier_counters_) {
+      tier_counters_ = TierRegistry::global().add(name);
+    }
+  }
+
+  /**
+   * Thresholds after which a function in `GENERATE_AUTO` mode is compiled:
+   * the number of evaluations on the CppAD tape, or their accumulated time
+   * in seconds, whichever is reached first. Functions below both thresholds
+   * are never compiled.
+   */
+  std::uint64_t auto_compile_calls() const { return auto_compile_calls_; }
+  double auto_compile_seconds() const { return auto_compile_seconds_; }
+  void set_auto_compile_threshold(std::uint64_t calls, double seconds) {
+    auto_compile_calls_ = calls;
+    auto_compile_seconds_ = seconds;
+  }
+
+  /**
+   * Counters of this function in `GENERATE_AUTO` mode (`nullptr` in the other
+   * modes), which are also listed by `TierRegistry::global()`.
+   */
+  std::shared_ptr<const TierCounters> tier_counters() const {
+    return tier_counters_;
   }
 
   void discard_library() {
+    wait_for_compilation_();
+    // also stops serving a failed background compilation from the fallback
+    use_fallback_ = false;
+    gen_fallback_.reset();
+    compilation_ = std::shared_future<void>();
     if (gen_cg_) {
-      // std::lock_guard<std::mutex> guard(compilation_mutex_);
       gen_cg_->discard_library();
     }
   }
   void load_precompiled_library(const std::string& path) {
+    wait_for_compilation_();
     if (gen_cg_) {
       gen_cg_->load_precompiled_library(path);
     }
@@ -111,11 +194,120 @@ struct Generated {
     return this->jac_acc_method_;
   }
   void set_jacobian_acc_method(AccumulationMethod jac_acc_method) {
-    if (jac_acc_method != this->jac_acc_method_) {
-      // changing the jac_acc_method discards the previously compiled library
+    if (jac_acc_method != this->jac_acc_method_ && mode_ == GENERATE_CUDA) {
+      // the CUDA kernels accumulate the Jacobian, so changing the
+      // jac_acc_method discards the previously compiled library
       discard_library();
     }
     this->jac_acc_method_ = jac_acc_method;
+    apply_accumulation_options_();
+  }
+
+  /**
+   * Whether `accumulated_jacobian()` uses Kahan-compensated summation.
+   */
+  bool compensated_summation() const { return compensated_summation_; }
+  void set_compensated_summation(bool option) {
+    compensated_summation_ = option;
+    apply_accumulation_options_();
+  }
+
+  /**
+   * Thread pool that runs the vectorized evaluations of the compiled CPU
+   * code. By default, all functions share `ThreadPool::global()`.
+   */
+  std::shared_ptr<ThreadPool> thread_pool() const {
+    return thread_pool_ ? thread_pool_ : ThreadPool::global();
+  }
+  void set_thread_pool(std::shared_ptr<ThreadPool> thread_pool) {
+    thread_pool_ = std::move(thread_pool);
+    if (gen_cg_) {
+      gen_cg_->set_thread_pool(thread_pool_);
+    }
+  }
+
+  /**
+   * Number of samples per work item of the thread pool in vectorized
+   * evaluations, where zero splits the batch into a few chunks per worker.
+   */
+  int batch_chunk_size() const { return batch_chunk_size_; }
+  void set_batch_chunk_size(int batch_chunk_size) {
+    batch_chunk_size_ = batch_chunk_size;
+    if (gen_cg_) {
+      gen_cg_->batch_chunk_size = batch_chunk_size_;
+    }
+  }
+
+  /**
+   * Whether the compiled code provides the Hessian (see `hessian()`). Changing
+   * this option discards the previously compiled library.
+   */
+  bool generate_hessian() const { return generate_hessian_; }
+  void set_generate_hessian(bool generate_hessian) {
+    if (generate_hessian != generate_hessian_) {
+      discard_library();
+    }
+    generate_hessian_ = generate_hessian;
+    if (gen_cg_) {
+      gen_cg_->generate_hessian = generate_hessian_;
+      gen_cg_->generate_directional_derivatives =
+          generate_directional_derivatives_;
+    }
+  }
+
+  /**
+   * Whether the compiled code provides the first-order forward and reverse
+   * functions for `jvp()` and `vjp()`. Otherwise these products are computed
+   * from the dense Jacobian. Changing this option discards the previously
+   * compiled library.
+   */
+  bool generate_directional_derivatives() const {
+    return generate_directional_derivatives_;
+  }
+  void set_generate_directional_derivatives(bool option) {
+    if (option != generate_directional_derivatives_) {
+      discard_library();
+    }
+    generate_directional_derivatives_ = option;
+    if (gen_cg_) {
+      gen_cg_->generate_directional_derivatives = option;
+    }
+  }
+
+  /**
+   * Whether the traced tapes are simplified by the stages of `options` before
+   * code is generated from them (see `GeneratedCodeGen::optimize_tapes`).
+   * Changing this option discards the previously compiled library.
+   */
+  bool optimize_tapes() const { return optimize_tapes_; }
+  const TapeOptimizationOptions& tape_optimization() const {
+    return tape_optimization_;
+  }
+  void set_optimize_tapes(bool option,
+                          const TapeOptimizationOptions& options = {}) {
+    if (option != optimize_tapes_) {
+      discard_library();
+    }
+    optimize_tapes_ = option;
+    tape_optimization_ = options;
+    if (gen_cg_) {
+      gen_cg_->optimize_tapes = option;
+      gen_cg_->tape_optimization = options;
+      gen_cg_->optimize_traced_tapes();
+    }
+  }
+
+  /**
+   * Directory of the persistent compilation cache for the CPU mode, which
+   * defaults to the environment variable `AUTOGEN_CACHE_DIR`. An empty string
+   * disables the cache. See `GeneratedCodeGen::cache_directory`.
+   */
+  const std::string& cache_directory() const { return cache_directory_; }
+  void set_cache_directory(const std::string& directory) {
+    cache_directory_ = directory;
+    if (gen_cg_) {
+      gen_cg_->cache_directory = cache_directory_;
+    }
   }
 
   int input_dim() const { return local_input_dim_ + global_input_dim_; }
@@ -125,12 +317,18 @@ struct Generated {
   bool debug_mode() const { return debug_mode_; }
   void set_debug_mode(bool debug_mode = true) { debug_mode_ = debug_mode; }
 
+  /**
+   * Sets the dimension of the thread-local input, which is required before
+   * calling the contiguous batch API on a function that has not been evaluated
+   * yet.
+   */
+  void set_local_input_dim(int local_input_dim) {
+    set_input_split_(global_input_dim_, local_input_dim);
+  }
+
   int global_input_dim() const { return global_input_dim_; }
   void set_global_input_dim(int global_input_dim) {
-    if (global_input_dim != global_input_dim_) {
-      // discard_library();
-    }
-    global_input_dim_ = global_input_dim;
+    set_input_split_(global_input_dim, local_input_dim_);
   }
 
   bool is_compiled() const {
@@ -141,19 +339,163 @@ struct Generated {
         return (bool)gen_cppad_;
       case GENERATE_CPU:
       case GENERATE_CUDA:
-        return gen_cg_ && gen_cg_->is_compiled();
+      case GENERATE_AUTO:
+      case GENERATE_JIT:
+        return !use_fallback_.load(std::memory_order_acquire) && gen_cg_ &&
+               gen_cg_->is_compiled();
     }
     return false;
   }
 
+  /**
+   * Whether a compilation started by `compile_async()` is still running.
+   */
   bool is_compiling() const {
-    //    std::lock_guard<std::mutex> guard(compilation_mutex_);
-    return is_compiling_;
+    return compilation_.valid() && compilation_.wait_for(std::chrono::seconds(
+                                       0)) != std::future_status::ready;
+  }
+
+  /**
+   * Traces the function on the given input and compiles it in the current
+   * CPU or CUDA mode on a separate thread. Until the compiled library is
+   * ready, evaluations are served by a CppAD tape of the function, after
+   * which they switch to the compiled code without blocking. Errors during
+   * the compilation are rethrown by the returned future, while the CppAD tape
+   * keeps serving the evaluations.
+   *
+   * Returns the pending compilation if one is running already, or a ready
+   * future if the function has been compiled before. In `GENERATE_AUTO` mode,
+   * this compiles the function regardless of the thresholds.
+   */
+  std::shared_future<void> compile_async(const std::vector<BaseScalar>& input) {
+    if (mode_ != GENERATE_CPU && mode_ != GENERATE_CUDA &&
+        mode_ != GENERATE_AUTO && mode_ != GENERATE_JIT) {
+      throw std::runtime_error(
+          "Function \"" + name +
+          "\" can only be compiled in CPU, CUDA, Auto or JIT mode.");
+    }
+    std::vector<BaseScalar> output(std::max(output_dim_, 0));
+    const bool in_background = compile_in_background;
+    compile_in_background = true;
+    try {
+      conditionally_compile(input, output);
+    } catch (...) {
+      compile_in_background = in_background;
+      throw;
+    }
+    compile_in_background = in_background;
+    if (mode_ == GENERATE_AUTO && use_fallback_.load()) {
+      std::lock_guard<std::mutex> guard(fallback_mutex_);
+      if (!compilation_.valid()) {
+        start_auto_compilation_();
+      }
+    }
+    if (!compilation_.valid()) {
+      std::promise<void> done;
+      done.set_value();
+      return done.get_future().share();
+    }
+    return compilation_;
+  }
+
+  /**
+   * Compiles the function for the CPU with profile-guided optimization in
+   * three steps: the library is compiled with instrumentation, the given
+   * representative batch is evaluated on it (forward pass and, if generated,
+   * Jacobian), and the library is compiled again using the recorded profile.
+   * The profile is stored with the compilation cache (see
+   * `GeneratedCodeGen::profile_directory()`), so that the instrumented
+   * compilation and the workload are skipped if the same function has been
+   * profiled before. Requires `GENERATE_CPU` mode.
+   */
+  void compile_profile_guided(
+      const std::vector<std::vector<BaseScalar>>& local_inputs,
+      const std::vector<BaseScalar>& global_input = {}) {
+    if (mode_ != GENERATE_CPU) {
+      throw std::runtime_error("Function \"" + name +
+                               "\" can only be compiled with profile-guided "
+                               "optimization in CPU mode.");
+    }
+    if (local_inputs.empty()) {
+      throw std::runtime_error(
+          "Profile-guided optimization of function \"" + name +
+          "\" requires a non-empty batch of inputs.");
+    }
+    discard_library();
+    global_input_dim_ = global_input.size();
+    local_input_dim_ = local_inputs[0].size();
+    std::vector<BaseScalar> input(global_input), output;
+    input.insert(input.end(), local_inputs[0].begin(), local_inputs[0].end());
+    if (output_dim_ <= 0) {
+      (*f_double_)(input, output);
+      output_dim_ = output.size();
+    }
+    output.resize(output_dim_);
+    create_code_generator_(input, output);
+
+    if (!gen_cg_->has_profile()) {
+      gen_cg_->pgo_stage = PGO_INSTRUMENT;
+      compile(GENERATE_CPU);
+      std::cout << "Profiling \"" << name << "\" on " << local_inputs.size()
+                << " samples...\n";
+      std::vector<std::vector<BaseScalar>> outputs;
+      GeneratedBaseT<BaseScalar>* gen = active_generator_();
+      if (gen_cg_->generate_forward) {
+        (*gen)(local_inputs, outputs, global_input);
+      }
+      if (gen_cg_->generate_jacobian) {
+        gen->jacobian(local_inputs, outputs, global_input);
+      }
+      // unloading the instrumented library writes the profile
+      gen_cg_->discard_library();
+    }
+    gen_cg_->pgo_stage = PGO_OPTIMIZE;
+    compile(GENERATE_CPU);
+    std::cout << "Finished profile-guided compilation.\n";
+  }
+
+  /**
+   * Compiles the function for the CPU with each of the compiler `variants`
+   * and keeps the fastest of those whose outputs and Jacobians on the sample
+   * `inputs` (global input followed by local input) match the CppAD tape of
+   * the function. The winning variant is persisted with the compilation cache
+   * and reused for the same function (see `GeneratedCodeGen::autotune()`).
+   * Requires `GENERATE_CPU` mode.
+   */
+  std::vector<AutotuneResult> autotune(
+      const std::vector<std::vector<BaseScalar>>& inputs,
+      const std::vector<CompileVariant>& variants =
+          CompileVariant::defaults()) {
+    if (mode_ != GENERATE_CPU) {
+      throw std::runtime_error("Function \"" + name +
+                               "\" can only be autotuned in CPU mode.");
+    }
+    if (inputs.empty()) {
+      throw std::runtime_error("Autotuning function \"" + name +
+                               "\" requires a non-empty batch of inputs.");
+    }
+    discard_library();
+    local_input_dim_ = static_cast<int>(inputs[0].size()) - global_input_dim_;
+    std::vector<BaseScalar> output;
+    if (output_dim_ <= 0) {
+      (*f_double_)(inputs[0], output);
+      output_dim_ = output.size();
+    }
+    output.resize(output_dim_);
+    create_code_generator_(inputs[0], output);
+    std::unique_ptr<GeneratedCppADT<BaseScalar>> reference =
+        record_cppad_tape_(inputs[0], output_dim_);
+    return gen_cg_->autotune(inputs, *reference, variants);
   }
 
   void operator()(const std::vector<BaseScalar>& input,
                   std::vector<BaseScalar>& output) {
     conditionally_compile(input, output);
+    if (evaluate_fallback_([&](GeneratedBaseT<BaseScalar>& gen) {
+          gen(input, output);
+        })) {
+      return;
+    }
 
     if (mode_ == GENERATE_NONE) {
       (*gen_double_)(input, output);
@@ -177,6 +519,11 @@ struct Generated {
     outputs.resize(local_inputs.size());
 
     conditionally_compile(local_inputs, outputs, global_input);
+    if (evaluate_fallback_([&](GeneratedBaseT<BaseScalar>& gen) {
+          gen(local_inputs, outputs, global_input);
+        })) {
+      return;
+    }
 
     if (mode_ == GENERATE_NONE) {
       (*gen_double_)(local_inputs, outputs, global_input);
@@ -187,9 +534,32 @@ struct Generated {
     }
   }
 
+  /**
+   * Vectorized execution of the forward pass on contiguous buffers. Row `i` of
+   * `local_inputs` holds the thread-local input of sample `i`, the global input
+   * (of dimension `global_input_dim()`) is shared by all samples unless its
+   * stride is nonzero.
+   */
+  void operator()(int num_samples, BatchView<const BaseScalar> local_inputs,
+                  BatchView<BaseScalar> outputs,
+                  BatchView<const BaseScalar> global_input = {}) {
+    if (num_samples <= 0) {
+      return;
+    }
+    conditionally_compile(local_inputs, global_input);
+    evaluate_([&](GeneratedBaseT<BaseScalar>& gen) {
+      gen(num_samples, local_inputs, outputs, global_input);
+    });
+  }
+
   void jacobian(const std::vector<BaseScalar>& input,
                 std::vector<BaseScalar>& output) {
     conditionally_compile(input, output);
+    if (evaluate_fallback_([&](GeneratedBaseT<BaseScalar>& gen) {
+          gen.jacobian(input, output);
+        })) {
+      return;
+    }
     if (mode_ == GENERATE_NONE) {
       gen_double_->jacobian(input, output);
       return;
@@ -207,6 +577,11 @@ struct Generated {
                 const std::vector<BaseScalar>& global_input = {}) {
     outputs.resize(local_inputs.size());
     conditionally_compile(local_inputs, outputs, global_input);
+    if (evaluate_fallback_([&](GeneratedBaseT<BaseScalar>& gen) {
+          gen.jacobian(local_inputs, outputs, global_input);
+        })) {
+      return;
+    }
     if (mode_ == GENERATE_NONE) {
       gen_double_->jacobian(local_inputs, outputs, global_input);
       return;
@@ -219,26 +594,373 @@ struct Generated {
     gen_cg_->jacobian(local_inputs, outputs, global_input);
   }
 
+  /**
+   * Vectorized execution of the Jacobian on contiguous buffers, where each row
+   * of `outputs` receives the row-major Jacobian of size
+   * `output_dim() * input_dim()`.
+   */
+  void jacobian(int num_samples, BatchView<const BaseScalar> local_inputs,
+                BatchView<BaseScalar> outputs,
+                BatchView<const BaseScalar> global_input = {}) {
+    if (num_samples <= 0) {
+      return;
+    }
+    conditionally_compile(local_inputs, global_input);
+    evaluate_([&](GeneratedBaseT<BaseScalar>& gen) {
+      gen.jacobian(num_samples, local_inputs, outputs, global_input);
+    });
+  }
+
+  /**
+   * Evaluates the outputs and the Jacobian on the same input, which shares
+   * the forward computations between both and compiles the function (if
+   * necessary) only once.
+   */
+  void value_and_jacobian(const std::vector<BaseScalar>& input,
+                          std::vector<BaseScalar>& output,
+                          std::vector<BaseScalar>& jac) {
+    conditionally_compile(input, output);
+    if (evaluate_fallback_([&](GeneratedBaseT<BaseScalar>& gen) {
+          gen.value_and_jacobian(input, output, jac);
+        })) {
+      return;
+    }
+    if (mode_ == GENERATE_NONE) {
+      gen_double_->value_and_jacobian(input, output, jac);
+      return;
+    }
+    if (mode_ == GENERATE_CPPAD) {
+      gen_cppad_->value_and_jacobian(input, output, jac);
+      return;
+    }
+
+    gen_cg_->value_and_jacobian(input, output, jac);
+  }
+
+  /**
+   * Vectorized version of `value_and_jacobian()` on contiguous buffers.
+   */
+  void value_and_jacobian(int num_samples,
+                          BatchView<const BaseScalar> local_inputs,
+                          BatchView<BaseScalar> outputs,
+                          BatchView<BaseScalar> jacobians,
+                          BatchView<const BaseScalar> global_input = {}) {
+    if (num_samples <= 0) {
+      return;
+    }
+    conditionally_compile(local_inputs, global_input);
+    evaluate_([&](GeneratedBaseT<BaseScalar>& gen) {
+      gen.value_and_jacobian(num_samples, local_inputs, outputs, jacobians,
+                             global_input);
+    });
+  }
+
+  /**
+   * Computes the row-major Hessian of the sum of the outputs weighted by
+   * `weights` (e.g. the Lagrange multipliers). Compiled code requires
+   * `set_generate_hessian(true)`.
+   */
+  void hessian(const std::vector<BaseScalar>& input,
+               const std::vector<BaseScalar>& weights,
+               std::vector<BaseScalar>& output) {
+    // the weights determine the output dimension
+    std::vector<BaseScalar> values(weights.size());
+    conditionally_compile(input, values);
+    if (evaluate_fallback_([&](GeneratedBaseT<BaseScalar>& gen) {
+          gen.hessian(input, weights, output);
+        })) {
+      return;
+    }
+    if (mode_ == GENERATE_NONE) {
+      gen_double_->hessian(input, weights, output);
+      return;
+    }
+    if (mode_ == GENERATE_CPPAD) {
+      gen_cppad_->hessian(input, weights, output);
+      return;
+    }
+
+    gen_cg_->hessian(input, weights, output);
+  }
+
+  /**
+   * Vectorized version of `hessian()` on contiguous buffers, where row `i` of
+   * `weights` holds the output weights of sample `i` (a stride of zero shares
+   * the weights between all samples).
+   */
+  void hessian(int num_samples, BatchView<const BaseScalar> local_inputs,
+               BatchView<const BaseScalar> weights,
+               BatchView<BaseScalar> outputs,
+               BatchView<const BaseScalar> global_input = {}) {
+    if (num_samples <= 0) {
+      return;
+    }
+    conditionally_compile(local_inputs, global_input);
+    evaluate_([&](GeneratedBaseT<BaseScalar>& gen) {
+      gen.hessian(num_samples, local_inputs, weights, outputs, global_input);
+    });
+  }
+
+  /**
+   * Jacobian-vector product `J(input) * tangent`.
+   */
+  void jvp(const std::vector<BaseScalar>& input,
+           const std::vector<BaseScalar>& tangent,
+           std::vector<BaseScalar>& output) {
+    conditionally_compile(input, output);
+    if (evaluate_fallback_([&](GeneratedBaseT<BaseScalar>& gen) {
+          gen.jvp(input, tangent, output);
+        })) {
+      return;
+    }
+    if (mode_ == GENERATE_NONE) {
+      gen_double_->jvp(input, tangent, output);
+      return;
+    }
+    if (mode_ == GENERATE_CPPAD) {
+      gen_cppad_->jvp(input, tangent, output);
+      return;
+    }
+
+    gen_cg_->jvp(input, tangent, output);
+  }
+
+  /**
+   * Vector-Jacobian product `cotangent^T * J(input)`, which requires a single
+   * reverse sweep (e.g. the gradient of a scalar function for a cotangent of
+   * one).
+   */
+  void vjp(const std::vector<BaseScalar>& input,
+           const std::vector<BaseScalar>& cotangent,
+           std::vector<BaseScalar>& output) {
+    // the cotangent determines the output dimension
+    std::vector<BaseScalar> values(cotangent.size());
+    conditionally_compile(input, values);
+    if (evaluate_fallback_([&](GeneratedBaseT<BaseScalar>& gen) {
+          gen.vjp(input, cotangent, output);
+        })) {
+      return;
+    }
+    if (mode_ == GENERATE_NONE) {
+      gen_double_->vjp(input, cotangent, output);
+      return;
+    }
+    if (mode_ == GENERATE_CPPAD) {
+      gen_cppad_->vjp(input, cotangent, output);
+      return;
+    }
+
+    gen_cg_->vjp(input, cotangent, output);
+  }
+
+  /**
+   * Vectorized version of `jvp()` on contiguous buffers, where row `i` of
+   * `tangents` holds the tangent of sample `i`.
+   */
+  void jvp(int num_samples, BatchView<const BaseScalar> local_inputs,
+           BatchView<const BaseScalar> tangents, BatchView<BaseScalar> outputs,
+           BatchView<const BaseScalar> global_input = {}) {
+    if (num_samples <= 0) {
+      return;
+    }
+    conditionally_compile(local_inputs, global_input);
+    evaluate_([&](GeneratedBaseT<BaseScalar>& gen) {
+      gen.jvp(num_samples, local_inputs, tangents, outputs, global_input);
+    });
+  }
+
+  /**
+   * Vectorized version of `vjp()` on contiguous buffers, where row `i` of
+   * `cotangents` holds the cotangent of sample `i`.
+   */
+  void vjp(int num_samples, BatchView<const BaseScalar> local_inputs,
+           BatchView<const BaseScalar> cotangents,
+           BatchView<BaseScalar> outputs,
+           BatchView<const BaseScalar> global_input = {}) {
+    if (num_samples <= 0) {
+      return;
+    }
+    conditionally_compile(local_inputs, global_input);
+    evaluate_([&](GeneratedBaseT<BaseScalar>& gen) {
+      gen.vjp(num_samples, local_inputs, cotangents, outputs, global_input);
+    });
+  }
+
+  /**
+   * Vectorized Jacobian where the Jacobians with respect to the global input
+   * are summed or averaged over the batch according to
+   * `jacobian_acc_method()`, while `local_jacobians` receives the Jacobian
+   * with respect to the local input of each sample. Not available in CUDA
+   * mode.
+   */
+  void accumulated_jacobian(int num_samples,
+                            BatchView<const BaseScalar> local_inputs,
+                            BatchView<BaseScalar> local_jacobians,
+                            BaseScalar* global_jacobian,
+                            BatchView<const BaseScalar> global_input = {}) {
+    if (mode_ == GENERATE_CUDA) {
+      // the CUDA Jacobian kernel returns a single accumulated row instead of
+      // the local Jacobians of the samples
+      throw std::runtime_error("The accumulated Jacobian of function \"" +
+                               name + "\" is not available in CUDA mode.");
+    }
+    if (num_samples <= 0) {
+      std::fill(global_jacobian,
+                global_jacobian + output_dim_ * global_input_dim_,
+                BaseScalar(0));
+      return;
+    }
+    conditionally_compile(local_inputs, global_input);
+    evaluate_([&](GeneratedBaseT<BaseScalar>& gen) {
+      gen.accumulated_jacobian(num_samples, local_inputs, local_jacobians,
+                               global_jacobian, global_input);
+    });
+  }
+
  protected:
-  void compile(const FunctionTrace<BaseScalar>& main_trace) {
-    {
-      // std::lock_guard<std::mutex> guard(compilation_mutex_);
-      is_compiling_ = true;
+  /**
+   * Forwards the Jacobian accumulation options to the generators that exist,
+   * so that evaluations only read them.
+   */
+  void apply_accumulation_options_() {
+    for (GeneratedBaseT<BaseScalar>* gen :
+         {static_cast<GeneratedBaseT<BaseScalar>*>(gen_double_.get()),
+          static_cast<GeneratedBaseT<BaseScalar>*>(gen_cppad_.get()),
+          static_cast<GeneratedBaseT<BaseScalar>*>(gen_fallback_.get()),
+          static_cast<GeneratedBaseT<BaseScalar>*>(gen_cg_.get())}) {
+      if (gen != nullptr) {
+        gen->set_jacobian_acc_method(jac_acc_method_);
+        gen->set_compensated_summation(compensated_summation_);
+      }
+    }
+  }
+
+  /**
+   * Sets the local and global input dimensions of this function and of the
+   * code generator. The compiled model receives the concatenated input, so
+   * the split can change without recompiling. The dimensions are only written
+   * if they change, so that concurrent evaluations with the same split only
+   * read them.
+   */
+  void set_input_split_(int global_input_dim, int local_input_dim) {
+    if (global_input_dim_ != global_input_dim) {
+      global_input_dim_ = global_input_dim;
+    }
+    if (local_input_dim_ != local_input_dim) {
+      local_input_dim_ = local_input_dim;
+    }
+    if (gen_cg_ && (gen_cg_->global_input_dim_ != global_input_dim ||
+                    gen_cg_->local_input_dim_ != local_input_dim)) {
+      gen_cg_->global_input_dim_ = global_input_dim;
+      gen_cg_->local_input_dim_ = local_input_dim;
+    }
+  }
+
+  /**
+   * Returns the generator of the current mode, with its input split matching
+   * the local and global input dimensions of this function (see
+   * `set_input_split_()` for the code generator).
+   */
+  GeneratedBaseT<BaseScalar>* active_generator_() {
+    GeneratedBaseT<BaseScalar>* gen = gen_cg_.get();
+    if (mode_ == GENERATE_NONE) {
+      gen = gen_double_.get();
+    } else if (mode_ == GENERATE_CPPAD) {
+      gen = gen_cppad_.get();
+    }
+    if (gen != gen_cg_.get() && gen->global_input_dim() != global_input_dim_) {
+      gen->set_global_input_dim(global_input_dim_);
+    }
+    return gen;
+  }
+
+  /**
+   * Calls `fun` on the CppAD fallback tape if the background compilation has
+   * not succeeded yet, and returns whether it did so. Concurrent evaluations
+   * of the fallback are serialized, while evaluations that observe the
+   * finished compilation proceed on the compiled code without locking.
+   */
+  template <typename Fun>
+  bool evaluate_fallback_(Fun&& fun) {
+    if (!use_fallback_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    std::lock_guard<std::mutex> guard(fallback_mutex_);
+    if (gen_fallback_->global_input_dim() != global_input_dim_) {
+      gen_fallback_->set_global_input_dim(global_input_dim_);
+    }
+    if (mode_ != GENERATE_AUTO || compilation_.valid()) {
+      fun(static_cast<GeneratedBaseT<BaseScalar>&>(*gen_fallback_));
+      return true;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    fun(static_cast<GeneratedBaseT<BaseScalar>&>(*gen_fallback_));
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    const std::uint64_t calls = ++tier_counters_->num_calls;
+    const std::uint64_t time_ns =
+        tier_counters_->evaluation_time_ns += elapsed.count();
+    if (calls >= auto_compile_calls_ ||
+        time_ns * 1e-9 >= auto_compile_seconds_) {
+      start_auto_compilation_();
     }
+    return true;
+  }
+
+  /**
+   * Promotes a function in `GENERATE_AUTO` mode from the CppAD tape to
+   * compiled CPU code, which is compiled in the background while the tape
+   * keeps serving the evaluations. Requires the fallback mutex to be held.
+   */
+  void start_auto_compilation_() {
+    std::cout << "Function \"" << name << "\" is hot after "
+              << tier_counters_->num_calls << " calls, compiling it.\n";
+    std::vector<BaseScalar> output(output_dim_);
+    create_code_generator_(auto_compile_input_, output);
+    tier_counters_->tier = TIER_COMPILING;
+    compile_in_background_(GENERATE_CPU);
+  }
 
-    gen_cg_->local_input_dim_ = this->local_input_dim_;
-    gen_cg_->global_input_dim_ = this->global_input_dim_;
-    gen_cg_->output_dim_ = this->output_dim_;
-    if (mode_ == GENERATE_CPU) {
+  /**
+   * Calls `fun` on the fallback tape during a background compilation, and on
+   * the generator of the current mode otherwise.
+   */
+  template <typename Fun>
+  void evaluate_(Fun&& fun) {
+    if (!evaluate_fallback_(fun)) {
+      fun(*active_generator_());
+    }
+  }
+
+  void wait_for_compilation_() {
+    if (compilation_.valid()) {
+      compilation_.wait();
+    }
+  }
+
+  void compile(GenerationMode mode) {
+    if (mode == GENERATE_CPU) {
       gen_cg_->compile_cpu();
-    } else if (mode_ == GENERATE_CUDA) {
+    } else if (mode == GENERATE_CUDA) {
       gen_cg_->compile_cuda();
+    } else if (mode == GENERATE_JIT) {
+      gen_cg_->compile_jit();
     }
+  }
 
-    {
-      // std::lock_guard<std::mutex> guard(compilation_mutex_);
-      is_compiling_ = false;
+  std::unique_ptr<GeneratedCppADT<BaseScalar>> record_cppad_tape_(
+      const std::vector<BaseScalar>& input, std::size_t output_dim) {
+    std::vector<CppAD::AD<BaseScalar>> ax(input.size()), ay(output_dim);
+    for (size_t i = 0; i < input.size(); ++i) {
+      ax[i] = ADScalar(input[i]);
     }
+    CppAD::Independent(ax);
+    (*f_cppad_)(ax, ay);
+    auto gen = std::make_unique<GeneratedCppADT<BaseScalar>>(
+        std::make_shared<CppAD::ADFun<BaseScalar>>(ax, ay));
+    gen->set_jacobian_acc_method(jac_acc_method_);
+    gen->set_compensated_summation(compensated_summation_);
+    return gen;
   }
 
   void conditionally_compile(const std::vector<BaseScalar>& input,
@@ -250,53 +972,131 @@ struct Generated {
       local_input_dim_ = input.size();
       output_dim_ = output.size();
     }
-    if (is_compiled()) {
+    if (is_compiled() || use_fallback_.load(std::memory_order_acquire)) {
       return;
     }
     if (mode_ == GENERATE_CPPAD) {
-      std::vector<CppAD::AD<BaseScalar>> ax_, ay_;
-      ax_.resize(input.size());
-      ay_.resize(output.size());
-      for (size_t i = 0; i < input.size(); ++i) {
-        ax_[i] = ADScalar(input[i]);
-      }
-      CppAD::Independent(ax_);
-      (*f_cppad_)(ax_, ay_);
-      gen_cppad_ = std::make_unique<GeneratedCppAD>(
-          std::make_shared<CppAD::ADFun<BaseScalar>>(ax_, ay_));
+      gen_cppad_ = record_cppad_tape_(input, output.size());
       return;
     }
-    if (mode_ == GENERATE_CPU || mode_ == GENERATE_CUDA) {
-      // std::lock_guard<std::mutex> guard(compilation_mutex_);
-
-      assert(!input.empty());
-      assert(!output.empty());
-      FunctionTrace<BaseScalar> t = autogen::trace(*f_cg_, name, input, output);
-      gen_cg_ = std::make_unique<GeneratedCodeGen>(t);
-      gen_cg_->debug_mode = debug_mode_;
+    if (mode_ == GENERATE_AUTO) {
+      // start in the CppAD tier, the compilation is triggered by
+      // evaluate_fallback_() once the function is hot
+      gen_fallback_ = record_cppad_tape_(input, output.size());
+      auto_compile_input_ = input;
+      tier_counters_->tier = TIER_CPPAD;
+      use_fallback_.store(true, std::memory_order_release);
+      return;
+    }
+    if (mode_ == GENERATE_CPU || mode_ == GENERATE_CUDA ||
+        mode_ == GENERATE_JIT) {
+      wait_for_compilation_();
+      create_code_generator_(input, output);
       if (compile_in_background) {
-        std::thread worker([this, &t]() { compile(t); });
-        (*f_double_)(input, output);
-        return;
+        // the tapes are recorded on the calling thread, since CppAD records
+        // into a tape per thread
+        gen_fallback_ = record_cppad_tape_(input, output.size());
+        use_fallback_.store(true, std::memory_order_release);
+        compile_in_background_(mode_);
       } else {
-        compile(t);
+        compilation_ = std::shared_future<void>();
+        compile(mode_);
         std::cout << "Finished compilation.\n";
       }
     }
   }
 
+  /**
+   * Traces the function for code generation and sets up `gen_cg_` with the
+   * options of this function.
+   */
+  void create_code_generator_(const std::vector<BaseScalar>& input,
+                              std::vector<BaseScalar>& output) {
+    assert(!input.empty());
+    assert(!output.empty());
+    FunctionTrace<BaseScalar> t = autogen::trace(*f_cg_, name, input, output);
+    gen_cg_ = std::make_unique<GeneratedCodeGenT<BaseScalar>>(t);
+    gen_cg_->debug_mode = debug_mode_;
+    gen_cg_->set_thread_pool(thread_pool_);
+    gen_cg_->batch_chunk_size = batch_chunk_size_;
+    gen_cg_->generate_hessian = generate_hessian_;
+    gen_cg_->generate_directional_derivatives =
+        generate_directional_derivatives_;
+    gen_cg_->set_jacobian_acc_method(jac_acc_method_);
+    gen_cg_->set_compensated_summation(compensated_summation_);
+    gen_cg_->cache_directory = cache_directory_;
+    gen_cg_->optimize_tapes = optimize_tapes_;
+    gen_cg_->tape_optimization = tape_optimization_;
+    gen_cg_->local_input_dim_ = local_input_dim_;
+    gen_cg_->global_input_dim_ = global_input_dim_;
+    gen_cg_->output_dim_ = output_dim_;
+    // re-records the tapes, which must not happen on a background compilation
+    gen_cg_->optimize_traced_tapes();
+  }
+
+  /**
+   * Compiles `gen_cg_` on a separate thread while `gen_fallback_` serves the
+   * evaluations.
+   */
+  void compile_in_background_(GenerationMode mode) {
+    compilation_ = std::async(std::launch::async, [this, mode]() {
+                     try {
+                       compile(mode);
+                     } catch (...) {
+                       if (tier_counters_) {
+                         tier_counters_->tier = TIER_CPPAD;
+                       }
+                       throw;
+                     }
+                     // hot-swap to the compiled library
+                     use_fallback_.store(false, std::memory_order_release);
+                     if (tier_counters_) {
+                       tier_counters_->tier = TIER_COMPILED;
+                     }
+                     std::cout << "Finished compilation of \"" << name
+                               << "\" in the background.\n";
+                   }).share();
+  }
+
   void conditionally_compile(
       const std::vector<std::vector<BaseScalar>>& local_inputs,
       std::vector<std::vector<BaseScalar>>& outputs,
       const std::vector<BaseScalar>& global_input) {
-    global_input_dim_ = global_input.size();
+    const int global_input_dim = static_cast<int>(global_input.size());
+    set_input_split_(global_input_dim, local_input_dim_);
     std::vector<BaseScalar> compilation_input;
     compilation_input.insert(compilation_input.end(), global_input.begin(),
                              global_input.end());
     compilation_input.insert(compilation_input.end(), local_inputs[0].begin(),
                              local_inputs[0].end());
     conditionally_compile(compilation_input, outputs[0]);
-    local_input_dim_ = local_inputs[0].size();
+    set_input_split_(global_input_dim,
+                     static_cast<int>(local_inputs[0].size()));
+  }
+
+  void conditionally_compile(BatchView<const BaseScalar> local_inputs,
+                             BatchView<const BaseScalar> global_input) {
+    if (local_input_dim_ <= 0) {
+      throw std::runtime_error(
+          "The local input dimension of function \"" + name +
+          "\" is unknown. Evaluate the function once or call "
+          "set_local_input_dim() before using the contiguous batch API.");
+    }
+    if (output_dim_ > 0 &&
+        (is_compiled() || use_fallback_.load(std::memory_order_acquire))) {
+      return;
+    }
+    const int local_input_dim = local_input_dim_;
+    std::vector<BaseScalar> compilation_input,
+        output(std::max(output_dim_, 0));
+    if (global_input_dim_ > 0) {
+      compilation_input.insert(compilation_input.end(), global_input[0],
+                               global_input[0] + global_input_dim_);
+    }
+    compilation_input.insert(compilation_input.end(), local_inputs[0],
+                             local_inputs[0] + local_input_dim);
+    conditionally_compile(compilation_input, output);
+    set_input_split_(global_input_dim_, local_input_dim);
   }
 };
 
@@ -0,0 +1,12 @@
+#pragma once
+
+/**
+ * Runtime-only subset of autogen that loads and calls CPU libraries which
+ * have been compiled beforehand (see `GeneratedLightWeight`). Unlike
+ * `autogen.hpp`, it does not depend on CppAD or CppADCodeGen.
+ */
+
+// clang-format off
+#include "core/base.hpp"
+#include "core/generated_lightweight.hpp"
+// clang-format on
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace autogen {
+/**
+ * Compiler settings of a CPU library that are compared by
+ * `GeneratedCodeGen::autotune()`.
+ */
+struct CompileVariant {
+  int optimization_level{2};
+  // additional compiler flags, e.g. "-march=native" or "-ffast-math"
+  std::vector<std::string> flags;
+  // see `GeneratedCodeGen::max_assignments_per_function`
+  std::size_t max_assignments_per_function{0};
+
+  std::string str() const {
+    std::ostringstream ss;
+    ss << "-O" << optimization_level;
+    for (const auto &flag : flags) {
+      ss << " " << flag;
+    }
+    if (max_assignments_per_function > 0) {
+      ss << " (max. " << max_assignments_per_function
+         << " assignments per function)";
+    }
+    return ss.str();
+  }
+
+  /**
+   * Variants that are compared unless specified otherwise, ranging from fast
+   * compilation to aggressive, possibly value-changing optimizations (which
+   * are rejected by the equivalence check if their error is too large).
+   */
+  static std::vector<CompileVariant> defaults() {
+    return {{1, {}, 0},
+            {2, {}, 0},
+            {3, {}, 0},
+            {3, {"-march=native"}, 0},
+            {3, {"-march=native", "-ffp-contract=fast"}, 0},
+            {3, {"-march=native", "-ffast-math"}, 0},
+            {2, {}, 2000},
+            {3, {"-march=native"}, 2000}};
+  }
+
+  /**
+   * Writes the variant to a text file with one setting per line.
+   */
+  void save(const std::string &filename) const {
+    std::ofstream file(filename);
+    if (!file) {
+      throw std::runtime_error("Failed to write \"" + filename + "\".");
+    }
+    file << "optimization_level " << optimization_level << "\n";
+    file << "max_assignments_per_function " << max_assignments_per_function
+         << "\n";
+    for (const auto &flag : flags) {
+      file << "flag " << flag << "\n";
+    }
+  }
+
+  /**
+   * Reads a variant written by `save()`, and returns whether the file
+   * exists.
+   */
+  bool load(const std::string &filename) {
+    std::ifstream file(filename);
+    if (!file) {
+      return false;
+    }
+    *this = CompileVariant();
+    std::string key;
+    while (file >> key) {
+      if (key == "optimization_level") {
+        file >> optimization_level;
+      } else if (key == "max_assignments_per_function") {
+        file >> max_assignments_per_function;
+      } else if (key == "flag") {
+        std::string flag;
+        file >> flag;
+        flags.push_back(flag);
+      } else {
+        throw std::runtime_error("Unknown setting \"" + key + "\" in \"" +
+                                 filename + "\".");
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * Outcome of compiling and benchmarking a `CompileVariant`.
+ */
+struct AutotuneResult {
+  CompileVariant variant;
+  // whether the variant compiled and matched the reference
+  bool valid{false};
+  // reason why the variant is not valid
+  std::string error;
+  // in seconds
+  double compile_time{0};
+  // best time of evaluating the sample batch once, in seconds
+  double run_time{0};
+  // largest relative deviation from the reference
+  double max_error{0};
+};
+}  // namespace autogen
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 namespace autogen {
@@ -8,13 +15,59 @@ using BaseScalar = double;
 
 enum AccumulationMethod { ACCUMULATE_NONE, ACCUMULATE_SUM, ACCUMULATE_MEAN };
 
-struct GeneratedBase {
+/**
+ * Non-owning view on a batch of row vectors that are stored in a single
+ * contiguous buffer. Row `i` starts at `data + i * stride`, a stride of zero
+ * broadcasts the same row to every sample in the batch.
+ */
+template <typename Scalar>
+struct BatchView {
+  Scalar *data{nullptr};
+  int stride{0};
+
+  BatchView() = default;
+  BatchView(Scalar *data, int stride) : data(data), stride(stride) {}
+
+  // allows passing mutable views where const views are expected
+  template <typename OtherScalar,
+            typename = std::enable_if_t<
+                std::is_convertible<OtherScalar *, Scalar *>::value>>
+  BatchView(const BatchView<OtherScalar> &other)
+      : data(other.data), stride(other.stride) {}
+
+  Scalar *operator[](int i) const {
+    return data + static_cast<std::ptrdiff_t>(i) * stride;
+  }
+
+  bool empty() const { return data == nullptr; }
+};
+
+/**
+ * Interface of the evaluators of a function, templated on the scalar type of
+ * the inputs and outputs (e.g. `float` to halve the memory traffic of batched
+ * evaluations).
+ */
+template <typename BaseScalar = double>
+struct GeneratedBaseT {
  protected:
   int local_input_dim_{-1};
   int global_input_dim_{0};
   int output_dim_{-1};
 
+  AccumulationMethod jac_acc_method_{ACCUMULATE_NONE};
+  bool compensated_summation_{false};
+
  public:
+  /**
+   * Number of samples whose global-input Jacobians are summed up sequentially
+   * before the partial sums are combined in a pairwise tree (see
+   * `accumulated_jacobian()`). Since the blocks do not depend on the number of
+   * threads, the accumulated result is deterministic.
+   */
+  static constexpr int kAccumulationBlockSize = 256;
+
+  virtual ~GeneratedBaseT() = default;
+
   virtual int local_input_dim() const { return local_input_dim_; }
   virtual int global_input_dim() const { return global_input_dim_; }
   virtual void set_global_input_dim(int dim) { global_input_dim_ = dim; }
@@ -25,6 +78,24 @@ struct GeneratedBase {
 
   virtual int output_dim() const { return output_dim_; }
 
+  /**
+   * Determines how the Jacobians with respect to the global input are
+   * accumulated over the samples of a batch.
+   */
+  AccumulationMethod jacobian_acc_method() const { return jac_acc_method_; }
+  virtual void set_jacobian_acc_method(AccumulationMethod method) {
+    jac_acc_method_ = method;
+  }
+
+  /**
+   * Whether the accumulation of global-input Jacobians uses Kahan-compensated
+   * summation within each block of samples.
+   */
+  bool compensated_summation() const { return compensated_summation_; }
+  void set_compensated_summation(bool option) {
+    compensated_summation_ = option;
+  }
+
   /**
    * Forward pass.
    */
@@ -43,34 +114,50 @@ struct GeneratedBase {
     }
   }
 
+  /**
+   * Vectorized version of the forward pass that operates on contiguous
+   * buffers. Each of the `num_samples` local inputs (of dimension
+   * `local_input_dim()`) is evaluated together with the global input (of
+   * dimension `global_input_dim()`), and the outputs are written to the rows
+   * of `outputs`.
+   */
+  virtual void operator()(int num_samples,
+                          BatchView<const BaseScalar> local_inputs,
+                          BatchView<BaseScalar> outputs,
+                          BatchView<const BaseScalar> global_input = {}) = 0;
+
   /**
    * Vectorized version of forward pass.
    */
   virtual void operator()(
       const std::vector<std::vector<BaseScalar>> &local_inputs,
       std::vector<std::vector<BaseScalar>> &outputs,
-      const std::vector<BaseScalar> &global_input = {}) = 0;
+      const std::vector<BaseScalar> &global_input = {}) {
+    if (local_inputs.empty()) {
+      return;
+    }
+    prepare_batch_(local_inputs, global_input);
+    const int num_samples = static_cast<int>(local_inputs.size());
+    const int ld = local_input_dim();
+    const int od = output_dim();
+    std::vector<BaseScalar> local_flat, output_flat(num_samples * od);
+    flatten_(local_inputs, ld, local_flat);
+    (*this)(num_samples, {local_flat.data(), ld}, {output_flat.data(), od},
+            {global_input.empty() ? nullptr : global_input.data(), 0});
+    unflatten_(output_flat, num_samples, od, outputs);
+  }
 
+  /**
+   * Forward pass over `num_total_threads` samples where `input` contains the
+   * global input followed by the local input of each sample.
+   */
   virtual void operator()(int num_total_threads, const BaseScalar *input,
                           BaseScalar *output) {
     const int gd = global_input_dim();
     const int ld = local_input_dim();
     const int od = output_dim();
-    std::vector<BaseScalar> global_input_vec(input, input + gd);
-    std::vector<std::vector<BaseScalar>> local_input_vec(num_total_threads);
-    std::vector<std::vector<BaseScalar>> output_vec(
-        num_total_threads, std::vector<BaseScalar>(od));
-    for (int i = 0; i < num_total_threads; ++i) {
-      local_input_vec[i] = std::vector<BaseScalar>(input + gd + i * ld,
-                                                   input + gd + (i + 1) * ld);
-    }
-    (*this)(local_input_vec, output_vec, global_input_vec);
-    int p = 0;
-    for (int i = 0; i < num_total_threads; ++i) {
-      for (int j = 0; j < od; ++j) {
-        output[p++] = output_vec[i][j];
-      }
-    }
+    (*this)(num_total_threads, {input + gd, ld}, {output, od},
+            {gd > 0 ? input : nullptr, 0});
   }
 
   /**
@@ -79,12 +166,370 @@ struct GeneratedBase {
   virtual void jacobian(const std::vector<BaseScalar> &input,
                         std::vector<BaseScalar> &output) = 0;
 
+  /**
+   * Jacobian pass on raw buffers, where `output` receives the row-major
+   * Jacobian of size `output_dim() * input_dim()`.
+   */
+  virtual void jacobian(const BaseScalar *input, BaseScalar *output) {
+    // if this function doesn't get overwritten we have to copy
+    std::vector<BaseScalar> input_vec(input, input + input_dim()), output_vec;
+    jacobian(input_vec, output_vec);
+    std::copy(output_vec.begin(), output_vec.end(), output);
+  }
+
+  /**
+   * Vectorized version of the Jacobian pass that operates on contiguous
+   * buffers. Each row of `outputs` receives the row-major Jacobian of size
+   * `output_dim() * input_dim()` for the corresponding sample.
+   */
+  virtual void jacobian(int num_samples,
+                        BatchView<const BaseScalar> local_inputs,
+                        BatchView<BaseScalar> outputs,
+                        BatchView<const BaseScalar> global_input = {}) = 0;
+
   /**
    * Vectorized version of Jacobian pass.
    */
   virtual void jacobian(
       const std::vector<std::vector<BaseScalar>> &local_inputs,
       std::vector<std::vector<BaseScalar>> &outputs,
-      const std::vector<BaseScalar> &global_input = {}) = 0;
+      const std::vector<BaseScalar> &global_input = {}) {
+    if (local_inputs.empty()) {
+      outputs.clear();
+      return;
+    }
+    prepare_batch_(local_inputs, global_input);
+    const int num_samples = static_cast<int>(local_inputs.size());
+    const int ld = local_input_dim();
+    const int jd = input_dim() * output_dim();
+    std::vector<BaseScalar> local_flat, output_flat(num_samples * jd);
+    flatten_(local_inputs, ld, local_flat);
+    jacobian(num_samples, {local_flat.data(), ld}, {output_flat.data(), jd},
+             {global_input.empty() ? nullptr : global_input.data(), 0});
+    unflatten_(output_flat, num_samples, jd, outputs);
+  }
+
+  /**
+   * Evaluates the forward pass and the Jacobian on the same input. Generators
+   * that can share the forward computations between both passes override
+   * this function.
+   */
+  virtual void value_and_jacobian(const std::vector<BaseScalar> &input,
+                                  std::vector<BaseScalar> &output,
+                                  std::vector<BaseScalar> &jac) {
+    (*this)(input, output);
+    jacobian(input, jac);
+  }
+
+  /**
+   * Vectorized version of `value_and_jacobian()` that operates on contiguous
+   * buffers, where the rows of `outputs` and `jacobians` receive the outputs
+   * and row-major Jacobians of the corresponding samples.
+   */
+  virtual void value_and_jacobian(
+      int num_samples, BatchView<const BaseScalar> local_inputs,
+      BatchView<BaseScalar> outputs, BatchView<BaseScalar> jacobians,
+      BatchView<const BaseScalar> global_input = {}) {
+    (*this)(num_samples, local_inputs, outputs, global_input);
+    jacobian(num_samples, local_inputs, jacobians, global_input);
+  }
+
+  /**
+   * Computes the row-major Hessian (of size `input_dim() * input_dim()`) of
+   * the weighted sum of the outputs, i.e. the sum of the output Hessians
+   * weighted by `weights` (of size `output_dim()`), as needed for the Hessian
+   * of a Lagrangian. Unless overridden, the Hessian is approximated by central
+   * differences of the Jacobian.
+   */
+  virtual void hessian(const std::vector<BaseScalar> &input,
+                       const std::vector<BaseScalar> &weights,
+                       std::vector<BaseScalar> &output) {
+    const std::size_t n = input.size();
+    const std::size_t m = weights.size();
+    const BaseScalar eps =
+        std::cbrt(std::numeric_limits<BaseScalar>::epsilon());
+    output.resize(n * n);
+    std::vector<BaseScalar> x(input), jac_plus, jac_minus;
+    for (std::size_t j = 0; j < n; ++j) {
+      const BaseScalar h = eps * std::max(BaseScalar(1), std::abs(input[j]));
+      x[j] = input[j] + h;
+      jacobian(x, jac_plus);
+      x[j] = input[j] - h;
+      jacobian(x, jac_minus);
+      x[j] = input[j];
+      for (std::size_t k = 0; k < n; ++k) {
+        BaseScalar sum = 0;
+        for (std::size_t i = 0; i < m; ++i) {
+          sum += weights[i] * (jac_plus[i * n + k] - jac_minus[i * n + k]);
+        }
+        output[j * n + k] = sum / (2 * h);
+      }
+    }
+  }
+
+  /**
+   * Vectorized version of `hessian()` on contiguous buffers, where row `i` of
+   * `weights` holds the output weights of sample `i` (a stride of zero shares
+   * the weights between all samples).
+   */
+  virtual void hessian(int num_samples,
+                       BatchView<const BaseScalar> local_inputs,
+                       BatchView<const BaseScalar> weights,
+                       BatchView<BaseScalar> outputs,
+                       BatchView<const BaseScalar> global_input = {}) {
+    const int od = output_dim();
+    std::vector<BaseScalar> input(input_dim()), w(od), output;
+    for (int i = 0; i < num_samples; ++i) {
+      assemble_input_(local_inputs[i], global_input[i], input.data(),
+                      i > 0 ? global_input[i - 1] : nullptr);
+      w.assign(weights[i], weights[i] + od);
+      hessian(input, w, output);
+      std::copy(output.begin(), output.end(), outputs[i]);
+    }
+  }
+
+  /**
+   * Jacobian-vector product `J(input) * tangent` (forward mode), where
+   * `tangent` has dimension `input_dim()`. Unless overridden, the dense
+   * Jacobian is evaluated and multiplied.
+   */
+  virtual void jvp(const std::vector<BaseScalar> &input,
+                   const std::vector<BaseScalar> &tangent,
+                   std::vector<BaseScalar> &output) {
+    std::vector<BaseScalar> jac;
+    jacobian(input, jac);
+    const std::size_t n = input.size();
+    const std::size_t m = jac.size() / n;
+    output.assign(m, BaseScalar(0));
+    for (std::size_t i = 0; i < m; ++i) {
+      for (std::size_t j = 0; j < n; ++j) {
+        output[i] += jac[i * n + j] * tangent[j];
+      }
+    }
+  }
+
+  /**
+   * Vector-Jacobian product `cotangent^T * J(input)` (reverse mode), where
+   * `cotangent` has dimension `output_dim()`. Unless overridden, the dense
+   * Jacobian is evaluated and multiplied.
+   */
+  virtual void vjp(const std::vector<BaseScalar> &input,
+                   const std::vector<BaseScalar> &cotangent,
+                   std::vector<BaseScalar> &output) {
+    std::vector<BaseScalar> jac;
+    jacobian(input, jac);
+    const std::size_t n = input.size();
+    const std::size_t m = cotangent.size();
+    output.assign(n, BaseScalar(0));
+    for (std::size_t i = 0; i < m; ++i) {
+      for (std::size_t j = 0; j < n; ++j) {
+        output[j] += cotangent[i] * jac[i * n + j];
+      }
+    }
+  }
+
+  /**
+   * Vectorized version of `jvp()` on contiguous buffers, where row `i` of
+   * `tangents` holds the tangent of sample `i`.
+   */
+  virtual void jvp(int num_samples, BatchView<const BaseScalar> local_inputs,
+                   BatchView<const BaseScalar> tangents,
+                   BatchView<BaseScalar> outputs,
+                   BatchView<const BaseScalar> global_input = {}) {
+    batch_product_(num_samples, local_inputs, tangents, input_dim(), outputs,
+                   global_input, &GeneratedBaseT::jvp);
+  }
+
+  /**
+   * Vectorized version of `vjp()` on contiguous buffers, where row `i` of
+   * `cotangents` holds the cotangent of sample `i`.
+   */
+  virtual void vjp(int num_samples, BatchView<const BaseScalar> local_inputs,
+                   BatchView<const BaseScalar> cotangents,
+                   BatchView<BaseScalar> outputs,
+                   BatchView<const BaseScalar> global_input = {}) {
+    batch_product_(num_samples, local_inputs, cotangents, output_dim(),
+                   outputs, global_input, &GeneratedBaseT::vjp);
+  }
+
+  /**
+   * Vectorized Jacobian that accumulates the Jacobians with respect to the
+   * global input over the batch according to `jacobian_acc_method()`
+   * (`ACCUMULATE_SUM` or `ACCUMULATE_MEAN`). Each row of `local_jacobians`
+   * receives the row-major Jacobian of size `output_dim() * local_input_dim()`
+   * with respect to the local input of the corresponding sample, and
+   * `global_jacobian` receives the accumulated Jacobian of size
+   * `output_dim() * global_input_dim()`.
+   *
+   * The samples are processed in blocks of `kAccumulationBlockSize`, so that
+   * the full per-sample Jacobians never exist for the whole batch at once.
+   */
+  virtual void accumulated_jacobian(
+      int num_samples, BatchView<const BaseScalar> local_inputs,
+      BatchView<BaseScalar> local_jacobians, BaseScalar *global_jacobian,
+      BatchView<const BaseScalar> global_input = {}) {
+    if (jac_acc_method_ == ACCUMULATE_NONE) {
+      throw std::runtime_error(
+          "The accumulated Jacobian requires the Jacobian accumulation method "
+          "ACCUMULATE_SUM or ACCUMULATE_MEAN.");
+    }
+    const int gd = global_input_dim();
+    const int ld = local_input_dim();
+    const int od = output_dim();
+    const int id = gd + ld;
+    const int block_dim = od * gd;
+    std::fill(global_jacobian, global_jacobian + block_dim, BaseScalar(0));
+    if (num_samples <= 0) {
+      return;
+    }
+    const int num_blocks = (num_samples + kAccumulationBlockSize - 1) /
+                           kAccumulationBlockSize;
+    std::vector<BaseScalar> partials(static_cast<std::size_t>(num_blocks) *
+                                     block_dim);
+    parallel_for_blocks_(num_blocks, [&](int b) {
+      const int begin = b * kAccumulationBlockSize;
+      const int end = std::min(num_samples, begin + kAccumulationBlockSize);
+      std::vector<BaseScalar> jac(static_cast<std::size_t>(end - begin) * od *
+                                  id);
+      jacobian(end - begin, {local_inputs[begin], local_inputs.stride},
+               {jac.data(), od * id},
+               {global_input[begin], global_input.stride});
+      BaseScalar *partial = &partials[static_cast<std::size_t>(b) * block_dim];
+      std::vector<BaseScalar> compensation(
+          compensated_summation_ ? block_dim : 0, BaseScalar(0));
+      for (int s = 0; s < end - begin; ++s) {
+        const BaseScalar *sample = &jac[static_cast<std::size_t>(s) * od * id];
+        BaseScalar *local_jac = local_jacobians[begin + s];
+        for (int r = 0; r < od; ++r) {
+          // the global input precedes the local input
+          const BaseScalar *row = sample + r * id;
+          std::copy(row + gd, row + id, local_jac + r * ld);
+          for (int c = 0; c < gd; ++c) {
+            const int k = r * gd + c;
+            if (compensated_summation_) {
+              const BaseScalar y = row[c] - compensation[k];
+              const BaseScalar t = partial[k] + y;
+              compensation[k] = (t - partial[k]) - y;
+              partial[k] = t;
+            } else {
+              partial[k] += row[c];
+            }
+          }
+        }
+      }
+    });
+    // pairwise tree reduction of the block sums
+    for (int width = 1; width < num_blocks; width *= 2) {
+      const int num_pairs = (num_blocks + 2 * width - 1) / (2 * width);
+      parallel_for_blocks_(num_pairs, [&](int p) {
+        const int left = 2 * width * p;
+        const int right = left + width;
+        if (right >= num_blocks) {
+          return;
+        }
+        BaseScalar *dst = &partials[static_cast<std::size_t>(left) * block_dim];
+        const BaseScalar *src =
+            &partials[static_cast<std::size_t>(right) * block_dim];
+        for (int k = 0; k < block_dim; ++k) {
+          dst[k] += src[k];
+        }
+      });
+    }
+    const BaseScalar scale =
+        jac_acc_method_ == ACCUMULATE_MEAN ? BaseScalar(1) / num_samples : 1;
+    for (int k = 0; k < block_dim; ++k) {
+      global_jacobian[k] = partials[k] * scale;
+    }
+  }
+
+ protected:
+  /**
+   * Updates the input split and the output dimension before a nested-vector
+   * batch is forwarded to the contiguous implementation.
+   */
+  virtual void prepare_batch_(
+      const std::vector<std::vector<BaseScalar>> &local_inputs,
+      const std::vector<BaseScalar> &global_input) {
+    if (static_cast<int>(global_input.size()) != global_input_dim()) {
+      set_global_input_dim(static_cast<int>(global_input.size()));
+    }
+    if (output_dim() < 0) {
+      // evaluate the first sample to discover the output dimension
+      std::vector<BaseScalar> input(global_input), output;
+      input.insert(input.end(), local_inputs[0].begin(),
+                   local_inputs[0].end());
+      (*this)(input, output);
+    }
+  }
+
+  /**
+   * Calls `fun(i)` for every `i` in `[0, n)`. Generators that can evaluate
+   * samples concurrently run the calls in parallel.
+   */
+  virtual void parallel_for_blocks_(int n,
+                                    const std::function<void(int)> &fun) {
+    for (int i = 0; i < n; ++i) {
+      fun(i);
+    }
+  }
+
+  using ProductFunction = void (GeneratedBaseT::*)(
+      const std::vector<BaseScalar> &, const std::vector<BaseScalar> &,
+      std::vector<BaseScalar> &);
+
+  // evaluates a single-sample derivative product on each sample of a batch
+  void batch_product_(int num_samples, BatchView<const BaseScalar> local_inputs,
+                      BatchView<const BaseScalar> vectors, int vector_dim,
+                      BatchView<BaseScalar> outputs,
+                      BatchView<const BaseScalar> global_input,
+                      ProductFunction product) {
+    std::vector<BaseScalar> input(input_dim()), vector(vector_dim), output;
+    for (int i = 0; i < num_samples; ++i) {
+      assemble_input_(local_inputs[i], global_input[i], input.data(),
+                      i > 0 ? global_input[i - 1] : nullptr);
+      vector.assign(vectors[i], vectors[i] + vector_dim);
+      (this->*product)(input, vector, output);
+      std::copy(output.begin(), output.end(), outputs[i]);
+    }
+  }
+
+  static void flatten_(const std::vector<std::vector<BaseScalar>> &rows,
+                       int dim, std::vector<BaseScalar> &flat) {
+    flat.resize(rows.size() * dim);
+    BaseScalar *dst = flat.data();
+    for (const auto &row : rows) {
+      std::copy(row.begin(), row.begin() + dim, dst);
+      dst += dim;
+    }
+  }
+
+  static void unflatten_(const std::vector<BaseScalar> &flat, int num_rows,
+                         int dim, std::vector<std::vector<BaseScalar>> &rows) {
+    rows.resize(num_rows);
+    const BaseScalar *src = flat.data();
+    for (auto &row : rows) {
+      row.assign(src, src + dim);
+      src += dim;
+    }
+  }
+
+  /**
+   * Writes the global input followed by the local input of a single sample
+   * into `input`, which has to be of size `input_dim()`. If `input` already
+   * holds the global input of the previous sample at `previous_global` (e.g.
+   * when the global input is shared by all samples), only the local input is
+   * copied.
+   */
+  void assemble_input_(const BaseScalar *local_input,
+                       const BaseScalar *global_input, BaseScalar *input,
+                       const BaseScalar *previous_global = nullptr) const {
+    const int gd = global_input_dim();
+    if (gd > 0 && global_input != previous_global) {
+      std::copy(global_input, global_input + gd, input);
+    }
+    std::copy(local_input, local_input + local_input_dim(), input + gd);
+  }
 };
-}  // namespace autogen
\ No newline at end of file
+
+using GeneratedBase = GeneratedBaseT<BaseScalar>;
+}  // namespace autogen
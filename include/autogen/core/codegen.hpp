@@ -7,6 +7,7 @@
 #include <cppad/cg/support/cppadcg_eigen.hpp>
 #endif
 
+#include "../utils/compilation_cache.hpp"
 #include "base.hpp"
 #include "types.h"
 
@@ -187,7 +188,86 @@ inline void call_atomic(const std::string &name, ADFunctor<BaseScalar> functor,
   // std::cout << std::endl;
 }
 
-template <typename Functor>
+/**
+ * Adds the operation graph of the given tape to the hash, i.e. the operations
+ * (with their parameters and references to atomic functions by name) that the
+ * code generators translate into source code. The nodes are numbered in the
+ * order of a depth-first traversal from the dependent variables, which makes
+ * the hash independent of the process that recorded the tape.
+ */
+template <typename BaseScalar>
+void hash_operation_graph(CppAD::ADFun<CppAD::cg::CG<BaseScalar>> &tape,
+                          Hasher &hasher) {
+  using CGScalar = typename CppAD::cg::CG<BaseScalar>;
+  using Node = typename CppAD::cg::OperationNode<BaseScalar>;
+  using CppAD::cg::CGOpCode;
+
+  CppAD::cg::CodeHandler<BaseScalar> handler;
+  std::vector<CGScalar> x(tape.Domain());
+  handler.makeVariables(x);
+  std::vector<CGScalar> y = tape.Forward(0, x);
+
+  std::map<const Node *, std::size_t> ids;
+  for (std::size_t j = 0; j < x.size(); ++j) {
+    ids[x[j].getOperationNode()] = j;
+  }
+  hasher.add(x.size()).add(y.size());
+  // iterative post-order traversal, since the graphs can be very deep
+  std::vector<std::pair<const Node *, bool>> stack;
+  for (const CGScalar &dep : y) {
+    if (dep.isParameter()) {
+      hasher.add('p').add(dep.getValue());
+      continue;
+    }
+    stack.emplace_back(dep.getOperationNode(), false);
+    while (!stack.empty()) {
+      const auto [node, expanded] = stack.back();
+      stack.pop_back();
+      if (ids.count(node) > 0) {
+        continue;
+      }
+      if (!expanded) {
+        stack.emplace_back(node, true);
+        for (const auto &arg : node->getArguments()) {
+          if (arg.getOperation() != nullptr) {
+            stack.emplace_back(arg.getOperation(), false);
+          }
+        }
+        continue;
+      }
+      const CGOpCode op = node->getOperationType();
+      hasher.add(op).add(node->getArguments().size());
+      for (const auto &arg : node->getArguments()) {
+        if (arg.getOperation() != nullptr) {
+          hasher.add('o').add(ids.at(arg.getOperation()));
+        } else {
+          hasher.add('p').add(*arg.getParameter());
+        }
+      }
+      const auto &info = node->getInfo();
+      hasher.add(info.size());
+      for (std::size_t k = 0; k < info.size(); ++k) {
+        if (k == 0 &&
+            (op == CGOpCode::AtomicForward || op == CGOpCode::AtomicReverse)) {
+          // atomic function IDs depend on the order of their creation
+          const std::string *name = handler.getAtomicFunctionName(info[0]);
+          hasher.add(name != nullptr ? *name : std::string());
+        } else {
+          hasher.add(info[k]);
+        }
+      }
+      const std::size_t id = ids.size();
+      ids[node] = id;
+    }
+    hasher.add('o').add(ids.at(dep.getOperationNode()));
+  }
+}
+
+/**
+ * Traces the given function for code generation in the scalar type of
+ * `input` and `output`.
+ */
+template <typename Functor, typename BaseScalar>
 static FunctionTrace<BaseScalar> trace(Functor functor, const std::string &name,
                                        const std::vector<BaseScalar> &input,
                                        std::vector<BaseScalar> &output) {
@@ -203,7 +283,7 @@ static FunctionTrace<BaseScalar> trace(Functor functor, const std::string &name,
     CodeGenData<BaseScalar>::is_dry_run = true;
     std::vector<ADCGScalar> ax(input.size()), ay(output.size());
     for (size_t i = 0; i < input.size(); ++i) {
-      ax[i] = ADCGScalar(to_double(input[i]));
+      ax[i] = ADCGScalar(input[i]);
     }
     functor(ax, ay);
     CodeGenData<BaseScalar>::is_dry_run = false;
@@ -220,7 +300,7 @@ static FunctionTrace<BaseScalar> trace(Functor functor, const std::string &name,
     trace.ax.resize(trace.input_dim);
     trace.ay.resize(trace.output_dim);
     for (size_t i = 0; i < trace.input_dim; ++i) {
-      trace.ax[i] = ADCGScalar(to_double(trace.trace_input[i]));
+      trace.ax[i] = ADCGScalar(trace.trace_input[i]);
     }
     CppAD::Independent(trace.ax);
     trace.functor(trace.ax, trace.ay);
@@ -236,7 +316,7 @@ static FunctionTrace<BaseScalar> trace(Functor functor, const std::string &name,
   std::vector<ADCGScalar> ax(input.size()), ay(output.size());
   std::cout << "Tracing function \"" << name << "\" for code generation...\n";
   for (size_t i = 0; i < input.size(); ++i) {
-    ax[i] = ADCGScalar(to_double(input[i]));
+    ax[i] = ADCGScalar(input[i]);
   }
   CppAD::Independent(ax);
   functor(ax, ay);
@@ -246,6 +326,12 @@ static FunctionTrace<BaseScalar> trace(Functor functor, const std::string &name,
   trace.bridge = new CGAtomicFunBridge(name, *(trace.tape), true);
   trace.input_dim = static_cast<int>(input.size());
   trace.output_dim = static_cast<int>(output.size());
+  // allows recording the tape again (see `retape()`)
+  trace.trace_input = input;
+  trace.functor = [functor](const std::vector<ADCGScalar> &x,
+                            std::vector<ADCGScalar> &y) mutable {
+    functor(x, y);
+  };
   return trace;
 }
 
@@ -1,29 +1,75 @@
 #pragma once
 
 // clang-format off
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <stdexcept>
 #include <string>
 #include <array>
 #include <thread>
+#include <vector>
 
 #include "../utils/conditionals.hpp"
+#include "../utils/stopwatch.hpp"
+#include "../utils/thread_pool.hpp"
 
 #include "../cuda/cuda_codegen.hpp"
 #include "../cuda/cuda_library_processor.hpp"
 #include "../cuda/cuda_library.hpp"
 
+#include "../cpu/cpu_batch_sourcegen.hpp"
+#include "../cpu/cpu_simd_sourcegen.hpp"
+#include "../cpu/soa.hpp"
+
+#include "autotune.hpp"
 #include "codegen.hpp"
+#include "sparsity.hpp"
+#include "tape_optimization.hpp"
 // clang-format on
 
+#if AUTOGEN_USE_LLVM
+#include <cppad/cg/model/llvm/llvm.hpp>
+#endif
+
 namespace autogen {
 
 enum CodeGenTarget { TARGET_CPU, TARGET_CUDA };
 
-class GeneratedCodeGen : public GeneratedBase {
-  template <template <typename> typename Functor>
+/**
+ * Stage of the profile-guided optimization of a CPU library (see
+ * `GeneratedCodeGen::pgo_stage`).
+ */
+enum ProfileGuidedStage {
+  // regular compilation
+  PGO_NONE,
+  // compiles the library with instrumentation that records a profile
+  PGO_INSTRUMENT,
+  // compiles the library optimized by the recorded profile
+  PGO_OPTIMIZE
+};
+
+/**
+ * Code-generated evaluator of a function traced in `BaseScalar`. The compiled
+ * CPU and CUDA code operates on the same scalar type, e.g. `float` kernels
+ * are emitted for functions traced via `GeneratedCodeGenT<float>`.
+ */
+template <typename BaseScalar = double>
+class GeneratedCodeGenT : public GeneratedBaseT<BaseScalar> {
+  using GeneratedBase = GeneratedBaseT<BaseScalar>;
+
+  template <template <typename> typename Functor, typename Scalar>
   friend struct Generated;
 
  public:
@@ -31,10 +77,10 @@ class GeneratedCodeGen : public GeneratedBase {
   using CGScalar = typename CppAD::AD<CppAD::cg::CG<BaseScalar>>;
   using ADFun = typename FunctionTrace<BaseScalar>::ADFun;
 
-  using AbstractCCompiler = typename CppAD::cg::AbstractCCompiler<double>;
-  using MsvcCompiler = typename CppAD::cg::MsvcCompiler<double>;
-  using ClangCompiler = typename CppAD::cg::ClangCompiler<double>;
-  using GccCompiler = typename CppAD::cg::GccCompiler<double>;
+  using AbstractCCompiler = typename CppAD::cg::AbstractCCompiler<BaseScalar>;
+  using MsvcCompiler = typename CppAD::cg::MsvcCompiler<BaseScalar>;
+  using ClangCompiler = typename CppAD::cg::ClangCompiler<BaseScalar>;
+  using GccCompiler = typename CppAD::cg::GccCompiler<BaseScalar>;
 
  private:
   using CGAtomicFunBridge =
@@ -48,9 +94,10 @@ class GeneratedCodeGen : public GeneratedBase {
  protected:
   using GeneratedBase::global_input_dim_;
   using GeneratedBase::local_input_dim_;
+  using GeneratedBase::jac_acc_method_;
   using GeneratedBase::output_dim_;
 
-  AccumulationMethod jac_acc_method_{ACCUMULATE_NONE};
+  using GeneratedBase::assemble_input_;
 
   // name of the compiled library
   std::string library_name_;
@@ -58,6 +105,21 @@ class GeneratedCodeGen : public GeneratedBase {
   std::string name_;
   FunctionTrace<BaseScalar> main_trace_;
 
+  // hash of the profile used by the PGO_OPTIMIZE stage
+  std::string profile_hash_;
+
+  // basename of the compiled CPU library and its build folders, which
+  // defaults to `<name>_cpu`
+  std::string cpu_build_name_;
+  // compiler flags of the variant applied by autotune()
+  std::vector<std::string> variant_flags_;
+  // whether the tape optimization pipeline has run on the traced tapes
+  bool tapes_optimized_{false};
+
+  // code generation evaluates the traced tapes, which cannot be used by
+  // several threads at once (e.g. by the variants of autotune())
+  static inline std::mutex source_generation_mutex_;
+
   mutable std::shared_ptr<CudaLibrary<BaseScalar>> cuda_library_{nullptr};
 
 #if AUTOGEN_SYSTEM_WIN
@@ -65,12 +127,75 @@ class GeneratedCodeGen : public GeneratedBase {
 #else
   typedef CppAD::cg::LinuxDynamicLib<BaseScalar> DynamicLib;
 #endif
-  mutable std::shared_ptr<DynamicLib> cpu_library_{nullptr};
-  mutable std::map<std::string, GenericModelPtr> cpu_models_;
+  // either a shared library loaded from disk or the in-memory library of
+  // compile_jit()
+  mutable std::shared_ptr<CppAD::cg::FunctorModelLibrary<BaseScalar>>
+      cpu_library_{nullptr};
+  // library compiled by compile_jit(), which cannot be reloaded from disk
+  std::shared_ptr<CppAD::cg::FunctorModelLibrary<BaseScalar>> jit_library_{
+      nullptr};
+
+  /**
+   * Instance of the compiled CPU model together with the atomic function
+   * models it has been wired up with.
+   */
+  struct CpuModelInstance {
+    std::map<std::string, GenericModelPtr> models;
+    GenericModel *model{nullptr};
+  };
+  // one instance per worker of the thread pool the library was loaded for
+  mutable std::vector<std::unique_ptr<CpuModelInstance>> cpu_worker_instances_;
+  mutable std::shared_ptr<ThreadPool> cpu_instances_pool_{nullptr};
+  // instances of threads that are not workers of the thread pool
+  mutable std::map<std::thread::id, std::unique_ptr<CpuModelInstance>>
+      cpu_thread_instances_;
+  mutable std::mutex cpu_library_loading_mutex_{};
+  mutable std::atomic<bool> cpu_library_loaded_{false};
+  // unique identifier of the loaded library to validate thread-local caches
+  mutable std::uint64_t cpu_library_id_{0};
+  static inline std::atomic<std::uint64_t> next_cpu_library_id_{1};
+
+  // batched entry points of the compiled CPU library
+  mutable CpuBatchFunction<BaseScalar> cpu_forward_zero_batch_;
+  mutable CpuBatchFunction<BaseScalar> cpu_jacobian_batch_;
+  mutable CpuBatchFunction<BaseScalar> cpu_value_and_jacobian_batch_;
+  mutable CpuBatchFunction<BaseScalar> cpu_sparse_jacobian_batch_;
+  // Jacobian sparsity pattern the sparse Jacobian function was compiled for
+  mutable SparsityPattern jacobian_sparsity_;
+
+  // sparsity pattern of the sparse Hessian in the compiled library, and the
+  // position of each CSR entry in the output of the library (if it differs)
+  mutable SparsityPattern hessian_sparsity_;
+  mutable std::vector<int> hessian_permutation_;
+  mutable CpuSimdFunction<BaseScalar> cpu_forward_zero_simd_;
+  mutable CpuSimdFunction<BaseScalar> cpu_jacobian_simd_;
+
+  // raw entry points for single-sample evaluations that bypass GenericModel,
+  // which are only valid for the input split they have been compiled for
+  mutable CpuBatchFunctionPtrT<BaseScalar> cpu_forward_zero_ptr_{nullptr};
+  mutable CpuBatchFunctionPtrT<BaseScalar> cpu_jacobian_ptr_{nullptr};
+  mutable CpuBatchFunctionPtrT<BaseScalar> cpu_value_and_jacobian_ptr_{
+      nullptr};
+
+  mutable std::shared_ptr<ThreadPool> thread_pool_{nullptr};
 
  public:
+  using GeneratedBase::global_input_dim;
+  using GeneratedBase::input_dim;
+  using GeneratedBase::jacobian;
+  using GeneratedBase::local_input_dim;
+  using GeneratedBase::output_dim;
+  using GeneratedBase::operator();
+
   int num_gpu_threads_per_block{32};
 
+  /**
+   * Number of samples that are evaluated by a worker of the thread pool at a
+   * time in vectorized CPU evaluations. If zero, the batch is split into a few
+   * chunks per worker.
+   */
+  int batch_chunk_size{0};
+
   /**
    * Whether the generated code is compiled in debug mode (only applies to CPU
    * and CUDA).
@@ -93,18 +218,220 @@ class GeneratedCodeGen : public GeneratedBase {
    */
   bool generate_jacobian{true};
 
+  /**
+   * Whether to additionally emit batched CPU functions into the compiled
+   * library that loop over all samples of a vectorized call in generated
+   * code. These are used if the global input dimension at call time matches
+   * the one the library was compiled with.
+   */
+  bool generate_batch{true};
+
+  /**
+   * Whether to generate the fused CPU function that evaluates the outputs and
+   * the Jacobian in one pass, sharing the operations of the forward pass (see
+   * `value_and_jacobian()`). Requires `generate_batch` and
+   * `generate_jacobian`.
+   */
+  bool generate_value_and_jacobian{true};
+
+  /**
+   * Whether to generate the CPU function that only computes the nonzero
+   * entries of the Jacobian (see `sparse_jacobian()`). The sparsity pattern
+   * is determined once at compile time and stored in the library. Requires
+   * `generate_batch`.
+   */
+  bool generate_sparse_jacobian{false};
+
+  /**
+   * Whether to generate the sparse Hessian of the weighted sum of the outputs
+   * (see `hessian()` and `sparse_hessian()`).
+   */
+  bool generate_hessian{false};
+
+  /**
+   * Whether to generate the first-order forward and reverse functions of the
+   * main function, which evaluate Jacobian-vector and vector-Jacobian
+   * products (see `jvp()` and `vjp()`) without forming the Jacobian.
+   */
+  bool generate_directional_derivatives{false};
+
+  /**
+   * Number of samples per block of the SIMD-across-samples functions that
+   * operate on inputs in structure-of-arrays layout (see `forward_zero_soa()`
+   * and `jacobian_soa()`). These are only generated for a width greater than
+   * zero, and only for functions without atomic functions.
+   */
+  int simd_width{0};
+
+  /**
+   * Whether single-sample CPU evaluations call the compiled batch functions
+   * directly through their function pointers, instead of going through the
+   * `GenericModel` interface of CppADCodeGen with its virtual dispatch and
+   * atomic function callbacks. Requires `generate_batch`.
+   */
+  bool call_function_pointers{true};
+
+  /**
+   * Directory of the persistent cache of compiled CPU libraries (see
+   * `CompilationCache`). If set, `compile_cpu()` hashes the traced operation
+   * graphs together with the code generation options and the compiler
+   * settings, and loads the library from the cache instead of generating and
+   * compiling its code again if the same function has been compiled before
+   * (by this or any other process). Defaults to the environment variable
+   * `AUTOGEN_CACHE_DIR`; the cache is disabled if the directory is empty.
+   */
+  std::string cache_directory{CompilationCache::directory_from_environment()};
+
+  /**
+   * Number of translation units of the CPU library that are compiled
+   * concurrently before the library is linked once. If zero, one job per
+   * hardware thread is used. A single job compiles the translation units one
+   * after another via CppADCodeGen's `DynamicModelLibraryProcessor`, which is
+   * also used for the MSVC compiler.
+   */
+  int num_compile_jobs{0};
+
+  /**
+   * Maximum number of assignments per generated C function of the main and
+   * atomic models. Larger functions are split into several functions (each
+   * in its own translation unit), which keeps the compile time of large
+   * models manageable and allows compiling them in parallel. Zero disables
+   * the splitting.
+   */
+  std::size_t max_assignments_per_function{0};
+
+  /**
+   * Whether the object files of the translation units of the CPU library are
+   * cached by the hash of their source code and the compiler settings, so
+   * that a recompilation only compiles the models whose operation graph has
+   * changed (e.g. after editing one atomic function) and relinks the
+   * library. The objects are stored in the `objects` subdirectory of
+   * `cache_directory`, or of the temporary folder of `cpu_compiler` if the
+   * compilation cache is disabled. Not supported by the MSVC compiler.
+   */
+  bool incremental_compilation{true};
+
+  /**
+   * Whether the traced tapes of the function and of its atomic functions are
+   * simplified by the stages in `tape_optimization` before any code is
+   * generated from them, which prints the number of operations of each tape
+   * after each stage. Smaller tapes are faster to generate code for and to
+   * compile, and lead to fewer temporaries in the generated code. The tapes
+   * are shared with the other generators of the same trace and are only
+   * optimized once.
+   */
+  bool optimize_tapes{false};
+  TapeOptimizationOptions tape_optimization;
+
+  /**
+   * Runs the tape optimization pipeline on the traced tapes if
+   * `optimize_tapes` is enabled and they have not been optimized yet. The
+   * compile functions call it as well, but since it records the tapes again
+   * it has to be called on the thread that traced the function before the
+   * compilation is moved to another thread.
+   */
+  void optimize_traced_tapes() {
+    if (!optimize_tapes || tapes_optimized_) {
+      return;
+    }
+    // other generators of the same trace may generate code from the tapes
+    std::lock_guard<std::mutex> lock(source_generation_mutex_);
+    optimize_traces(main_trace_, tape_optimization);
+    tapes_optimized_ = true;
+  }
+
+  /**
+   * Include directories of the in-process Clang compiler used by
+   * `compile_jit()`, which may need the directory of the C standard headers
+   * (e.g. `math.h`) if it cannot find them on its own.
+   */
+  std::vector<std::string> jit_include_paths;
+
+  /**
+   * Stage of the profile-guided optimization of the CPU library, which is
+   * supported by the Clang and GCC compilers (see
+   * `Generated::compile_profile_guided()`). With `PGO_INSTRUMENT`,
+   * `compile_cpu()` builds an instrumented library that writes the profile of
+   * its evaluations to `profile_directory()` when it is unloaded. With
+   * `PGO_OPTIMIZE`, the library is compiled using the recorded profile, where
+   * the raw profiles written by Clang are merged via `llvm-profdata` first.
+   */
+  ProfileGuidedStage pgo_stage{PGO_NONE};
+
+  /**
+   * Directory of the profiles recorded by the instrumented CPU library, which
+   * is located in the `profiles` subdirectory of `cache_directory` (or in
+   * `./<name>_cpu_profiles` if the cache is disabled). The directory is
+   * specific to the operation graph, the code generation options and the
+   * compiler settings of the function, so that outdated profiles are not
+   * used.
+   */
+  std::string profile_directory() {
+    setup_cpu_compiler_();
+    namespace fs = std::filesystem;
+    const fs::path root =
+        cache_directory.empty()
+            ? fs::path("./" + name_ + "_cpu_profiles")
+            : fs::path(cache_directory) / "profiles";
+    return (root / (name_ + "_" + cpu_cache_key_(false))).string();
+  }
+
+  /**
+   * Whether a profile has been recorded in `profile_directory()`.
+   */
+  bool has_profile() {
+    namespace fs = std::filesystem;
+    const fs::path directory = profile_directory();
+    if (!fs::exists(directory)) {
+      return false;
+    }
+    for (const auto &entry : fs::recursive_directory_iterator(directory)) {
+      const fs::path ext = entry.path().extension();
+      if (ext == ".profraw" || ext == ".profdata" || ext == ".gcda") {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Thread pool that runs the vectorized CPU evaluations. Unless set
+   * explicitly, the pool returned by `ThreadPool::global()` is used which is
+   * shared by all functions.
+   */
+  const std::shared_ptr<ThreadPool> &thread_pool() const {
+    if (!thread_pool_) {
+      thread_pool_ = ThreadPool::global();
+    }
+    return thread_pool_;
+  }
+  void set_thread_pool(std::shared_ptr<ThreadPool> thread_pool) {
+    thread_pool_ = std::move(thread_pool);
+  }
+
+  /**
+   * On the CUDA target, the accumulation is compiled into the Jacobian
+   * kernel, so that changing the method discards the compiled library.
+   */
+  void set_jacobian_acc_method(AccumulationMethod method) override {
+    if (method != jac_acc_method_ && target_ == TARGET_CUDA) {
+      discard_library();
+    }
+    jac_acc_method_ = method;
+  }
+
   CodeGenTarget target() const { return target_; }
   void set_target(CodeGenTarget target) { target_ = target; }
 
   std::shared_ptr<AbstractCCompiler> cpu_compiler{nullptr};
 
-  GeneratedCodeGen(const FunctionTrace<BaseScalar> &main_trace)
+  GeneratedCodeGenT(const FunctionTrace<BaseScalar> &main_trace)
       : name_(main_trace.name), main_trace_(main_trace) {
     output_dim_ = main_trace_.output_dim;
     local_input_dim_ = main_trace_.input_dim;
   }
 
-  GeneratedCodeGen(const std::string &name, std::shared_ptr<ADFun> tape)
+  GeneratedCodeGenT(const std::string &name, std::shared_ptr<ADFun> tape)
       : name_(name) {
     main_trace_.tape = tape;
     output_dim_ = static_cast<int>(tape->Range());
@@ -169,11 +496,24 @@ class GeneratedCodeGen : public GeneratedBase {
 
   // discards the compiled library (so that it gets recompiled at the next
   // evaluation)
-  void discard_library() { library_name_ = ""; }
+  void discard_library() {
+    library_name_ = "";
+    unload_cpu_library_();
+    jit_library_ = nullptr;
+  }
 
   const std::string &library_name() const { return library_name_; }
+
+  /**
+   * Basename of the shared library written by `compile_cpu()` and of its
+   * build folders, which defaults to `<name>_cpu`.
+   */
+  std::string cpu_build_name() const {
+    return cpu_build_name_.empty() ? name_ + "_cpu" : cpu_build_name_;
+  }
+  void set_cpu_build_name(const std::string &name) { cpu_build_name_ = name; }
   void load_precompiled_library(const std::string &library_name) {
-    if (library_name != library_name_) {
+    if (library_name != library_name_ || jit_library_) {
       discard_library();
     }
     library_name_ = library_name;
@@ -191,6 +531,14 @@ class GeneratedCodeGen : public GeneratedBase {
                   std::vector<BaseScalar> &output) override {
     if (target_ == TARGET_CPU) {
       assert(!library_name_.empty());
+      load_cpu_library_if_needed_();
+      const auto fun =
+          single_sample_fun_(cpu_forward_zero_batch_, cpu_forward_zero_ptr_);
+      if (call_function_pointers && fun) {
+        output.resize(cpu_forward_zero_batch_.output_dim());
+        call_single_(fun, input.data(), output.data());
+        return;
+      }
       auto model = get_cpu_model();
       model->ForwardZero(input, output);
     } else if (target_ == TARGET_CUDA) {
@@ -199,43 +547,99 @@ class GeneratedCodeGen : public GeneratedBase {
     }
   }
 
+  /**
+   * Forward pass on raw buffers, which does not allocate memory when the CPU
+   * library is loaded.
+   */
+  void operator()(const BaseScalar *input, BaseScalar *output) override {
+    if (target_ != TARGET_CPU) {
+      GeneratedBase::operator()(input, output);
+      return;
+    }
+    assert(!library_name_.empty());
+    load_cpu_library_if_needed_();
+    const auto fun =
+        single_sample_fun_(cpu_forward_zero_batch_, cpu_forward_zero_ptr_);
+    if (call_function_pointers && fun) {
+      call_single_(fun, input, output);
+      return;
+    }
+    using CppAD::cg::ArrayView;
+    const int n = input_dim();
+    get_cpu_model()->ForwardZero(ArrayView<const BaseScalar>(input, n),
+                                 ArrayView<BaseScalar>(output, output_dim()));
+  }
+
+  void operator()(int num_samples, BatchView<const BaseScalar> local_inputs,
+                  BatchView<BaseScalar> outputs,
+                  BatchView<const BaseScalar> global_input = {}) override {
+    if (target_ == TARGET_CUDA) {
+      // CUDA models only expose the nested-vector interface
+      std::vector<std::vector<BaseScalar>> local_vec, output_vec;
+      std::vector<BaseScalar> global_vec;
+      to_nested_(num_samples, local_inputs, global_input, local_vec,
+                 global_vec);
+      (*this)(local_vec, output_vec, global_vec);
+      from_nested_(output_vec, outputs);
+      return;
+    }
+    assert(!library_name_.empty());
+    using CppAD::cg::ArrayView;
+    const int gd = global_input_dim();
+    const int ld = local_input_dim();
+    const int od = output_dim();
+    get_cpu_model();
+    if (cpu_forward_zero_batch_.is_available() &&
+        cpu_forward_zero_batch_.global_input_dim() == gd) {
+      run_cpu_batch_(cpu_forward_zero_batch_, num_samples, local_inputs,
+                     outputs, global_input);
+      return;
+    }
+    thread_pool()->parallel_for(
+        num_samples, batch_chunk_size, [&](int begin, int end) {
+          auto model = get_cpu_model();
+          std::vector<BaseScalar> input(gd > 0 ? gd + ld : 0);
+          for (int i = begin; i < end; ++i) {
+            if (gd == 0) {
+              model->ForwardZero(
+                  ArrayView<const BaseScalar>(local_inputs[i], ld),
+                  ArrayView<BaseScalar>(outputs[i], od));
+            } else {
+              assemble_input_(local_inputs[i], global_input[i], input.data(),
+                              i > begin ? global_input[i - 1] : nullptr);
+              model->ForwardZero(
+                  ArrayView<const BaseScalar>(input.data(), gd + ld),
+                  ArrayView<BaseScalar>(outputs[i], od));
+            }
+          }
+        });
+  }
+
   void operator()(const std::vector<std::vector<BaseScalar>> &local_inputs,
                   std::vector<std::vector<BaseScalar>> &outputs,
                   const std::vector<BaseScalar> &global_input) override {
-    outputs.resize(local_inputs.size());
-    if (target_ == TARGET_CPU) {
-      assert(!library_name_.empty());
-      for (auto &o : outputs) {
-        o.resize(output_dim_);
-      }
-      int num_tasks = static_cast<int>(local_inputs.size());
-#pragma omp parallel for
-      for (int i = 0; i < num_tasks; ++i) {
-        if (global_input.empty()) {
-          auto model = get_cpu_model();
-          model->ForwardZero(local_inputs[i], outputs[i]);
-        } else {
-          static thread_local std::vector<BaseScalar> input;
-          input = global_input;
-          input.resize(global_input.size() + local_inputs[0].size());
-          for (size_t j = 0; j < local_inputs[i].size(); ++j) {
-            input[j + global_input.size()] = local_inputs[i][j];
-          }
-          auto model = get_cpu_model();
-          model->ForwardZero(input, outputs[i]);
-        }
-      }
-    } else if (target_ == TARGET_CUDA) {
+    if (target_ == TARGET_CUDA) {
+      outputs.resize(local_inputs.size());
       const auto &model = get_cuda_model();
       model.forward_zero(&outputs, local_inputs, num_gpu_threads_per_block,
                          global_input);
+      return;
     }
+    GeneratedBase::operator()(local_inputs, outputs, global_input);
   }
 
   void jacobian(const std::vector<BaseScalar> &input,
                 std::vector<BaseScalar> &output) override {
     if (target_ == TARGET_CPU) {
       assert(!library_name_.empty());
+      load_cpu_library_if_needed_();
+      const auto fun =
+          single_sample_fun_(cpu_jacobian_batch_, cpu_jacobian_ptr_);
+      if (call_function_pointers && fun) {
+        output.resize(cpu_jacobian_batch_.output_dim());
+        call_single_(fun, input.data(), output.data());
+        return;
+      }
       auto model = get_cpu_model();
       model->Jacobian(input, output);
     } else if (target_ == TARGET_CUDA) {
@@ -244,50 +648,790 @@ class GeneratedCodeGen : public GeneratedBase {
     }
   }
 
+  /**
+   * Jacobian pass on raw buffers, which does not allocate memory when the CPU
+   * library is loaded.
+   */
+  void jacobian(const BaseScalar *input, BaseScalar *output) override {
+    if (target_ != TARGET_CPU) {
+      GeneratedBase::jacobian(input, output);
+      return;
+    }
+    assert(!library_name_.empty());
+    load_cpu_library_if_needed_();
+    const auto fun = single_sample_fun_(cpu_jacobian_batch_, cpu_jacobian_ptr_);
+    if (call_function_pointers && fun) {
+      call_single_(fun, input, output);
+      return;
+    }
+    using CppAD::cg::ArrayView;
+    const int n = input_dim();
+    get_cpu_model()->Jacobian(ArrayView<const BaseScalar>(input, n),
+                              ArrayView<BaseScalar>(output, n * output_dim()));
+  }
+
+  void jacobian(int num_samples, BatchView<const BaseScalar> local_inputs,
+                BatchView<BaseScalar> outputs,
+                BatchView<const BaseScalar> global_input = {}) override {
+    if (target_ == TARGET_CUDA) {
+      // CUDA models only expose the nested-vector interface
+      std::vector<std::vector<BaseScalar>> local_vec, output_vec;
+      std::vector<BaseScalar> global_vec;
+      to_nested_(num_samples, local_inputs, global_input, local_vec,
+                 global_vec);
+      jacobian(local_vec, output_vec, global_vec);
+      from_nested_(output_vec, outputs);
+      return;
+    }
+    assert(!library_name_.empty());
+    using CppAD::cg::ArrayView;
+    const int gd = global_input_dim();
+    const int ld = local_input_dim();
+    const int jd = (gd + ld) * output_dim();
+    get_cpu_model();
+    if (cpu_jacobian_batch_.is_available() &&
+        cpu_jacobian_batch_.global_input_dim() == gd) {
+      run_cpu_batch_(cpu_jacobian_batch_, num_samples, local_inputs, outputs,
+                     global_input);
+      return;
+    }
+    thread_pool()->parallel_for(
+        num_samples, batch_chunk_size, [&](int begin, int end) {
+          auto model = get_cpu_model();
+          std::vector<BaseScalar> input(gd > 0 ? gd + ld : 0);
+          for (int i = begin; i < end; ++i) {
+            if (gd == 0) {
+              model->Jacobian(
+                  ArrayView<const BaseScalar>(local_inputs[i], ld),
+                  ArrayView<BaseScalar>(outputs[i], jd));
+            } else {
+              assemble_input_(local_inputs[i], global_input[i], input.data(),
+                              i > begin ? global_input[i - 1] : nullptr);
+              model->Jacobian(
+                  ArrayView<const BaseScalar>(input.data(), gd + ld),
+                  ArrayView<BaseScalar>(outputs[i], jd));
+            }
+          }
+        });
+  }
+
   void jacobian(const std::vector<std::vector<BaseScalar>> &local_inputs,
                 std::vector<std::vector<BaseScalar>> &outputs,
                 const std::vector<BaseScalar> &global_input) override {
-    outputs.resize(local_inputs.size());
+    if (target_ == TARGET_CUDA) {
+      outputs.resize(local_inputs.size());
+      const auto &model = get_cuda_model();
+      model.jacobian(&outputs, local_inputs, num_gpu_threads_per_block,
+                     global_input);
+      return;
+    }
+    GeneratedBase::jacobian(local_inputs, outputs, global_input);
+  }
+
+  void value_and_jacobian(const std::vector<BaseScalar> &input,
+                          std::vector<BaseScalar> &output,
+                          std::vector<BaseScalar> &jac) override {
     if (target_ == TARGET_CPU) {
       assert(!library_name_.empty());
-      for (auto &o : outputs) {
-        o.resize(input_dim() * output_dim_);
+      load_cpu_library_if_needed_();
+      const auto fun = single_sample_fun_(cpu_value_and_jacobian_batch_,
+                                          cpu_value_and_jacobian_ptr_);
+      if (call_function_pointers && fun) {
+        const int od = output_dim();
+        const int jd = od * input_dim();
+        static thread_local std::vector<BaseScalar> fused;
+        fused.resize(od + jd);
+        call_single_(fun, input.data(), fused.data());
+        output.assign(fused.begin(), fused.begin() + od);
+        jac.assign(fused.begin() + od, fused.end());
+        return;
       }
-      int num_tasks = static_cast<int>(local_inputs.size());
-#pragma omp parallel for
-      for (int i = 0; i < num_tasks; ++i) {
-        if (global_input.empty()) {
-          auto model = get_cpu_model();
-          // model->ForwardZero(local_inputs[i], outputs[i]);
-          model->Jacobian(local_inputs[i], outputs[i]);
+    }
+    GeneratedBase::value_and_jacobian(input, output, jac);
+  }
+
+  void value_and_jacobian(
+      int num_samples, BatchView<const BaseScalar> local_inputs,
+      BatchView<BaseScalar> outputs, BatchView<BaseScalar> jacobians,
+      BatchView<const BaseScalar> global_input = {}) override {
+    if (target_ == TARGET_CPU) {
+      assert(!library_name_.empty());
+      load_cpu_library_if_needed_();
+      const auto fun = single_sample_fun_(cpu_value_and_jacobian_batch_,
+                                          cpu_value_and_jacobian_ptr_);
+      if (call_function_pointers && fun) {
+        const int od = output_dim();
+        const int jd = od * input_dim();
+        // the fused function writes outputs and Jacobian contiguously, which
+        // matches the given buffers if each Jacobian follows its output
+        const bool in_place = jacobians.data == outputs.data + od &&
+                              jacobians.stride == outputs.stride &&
+                              outputs.stride >= od + jd;
+        thread_pool()->parallel_for(
+            num_samples, batch_chunk_size, [&](int begin, int end) {
+              if (in_place) {
+                fun(end - begin, outputs[begin], outputs.stride,
+                    local_inputs[begin], local_inputs.stride,
+                    global_input[begin], global_input.stride);
+                return;
+              }
+              static thread_local std::vector<BaseScalar> fused;
+              fused.resize(static_cast<std::size_t>(end - begin) * (od + jd));
+              fun(end - begin, fused.data(), od + jd, local_inputs[begin],
+                  local_inputs.stride, global_input[begin],
+                  global_input.stride);
+              for (int i = begin; i < end; ++i) {
+                const BaseScalar *row = &fused[(i - begin) * (od + jd)];
+                std::copy(row, row + od, outputs[i]);
+                std::copy(row + od, row + od + jd, jacobians[i]);
+              }
+            });
+        return;
+      }
+    }
+    GeneratedBase::value_and_jacobian(num_samples, local_inputs, outputs,
+                                      jacobians, global_input);
+  }
+
+  /**
+   * Dense Hessian of the weighted sum of the outputs, scattered from the
+   * sparse Hessian of the compiled library.
+   */
+  void hessian(const std::vector<BaseScalar> &input,
+               const std::vector<BaseScalar> &weights,
+               std::vector<BaseScalar> &output) override {
+    const auto &pattern = hessian_sparsity();
+    static thread_local std::vector<BaseScalar> values;
+    sparse_hessian(input, weights, values);
+    output.resize(pattern.num_rows * pattern.num_cols);
+    pattern.to_dense(values.data(), output.data());
+  }
+
+  void hessian(int num_samples, BatchView<const BaseScalar> local_inputs,
+               BatchView<const BaseScalar> weights,
+               BatchView<BaseScalar> outputs,
+               BatchView<const BaseScalar> global_input = {}) override {
+    const auto &pattern = hessian_sparsity();
+    eval_sparse_hessian_(num_samples, local_inputs, weights, global_input,
+                         [&](int i, const BaseScalar *values) {
+                           pattern.to_dense(values, outputs[i]);
+                         });
+  }
+
+  /**
+   * Only supported by the CPU target, see
+   * `GeneratedBase::accumulated_jacobian()`.
+   */
+  void accumulated_jacobian(
+      int num_samples, BatchView<const BaseScalar> local_inputs,
+      BatchView<BaseScalar> local_jacobians, BaseScalar *global_jacobian,
+      BatchView<const BaseScalar> global_input = {}) override {
+    if (target_ != TARGET_CPU) {
+      throw std::runtime_error(
+          "The accumulated Jacobian with separate local Jacobians is only "
+          "available for the CPU target. The CUDA Jacobian kernel accumulates "
+          "the entire Jacobian according to `jacobian_acc_method()`.");
+    }
+    GeneratedBase::accumulated_jacobian(num_samples, local_inputs,
+                                        local_jacobians, global_jacobian,
+                                        global_input);
+  }
+
+  /**
+   * Jacobian-vector product via the generated first-order forward functions,
+   * which requires the library to be compiled with
+   * `generate_directional_derivatives`. Otherwise the dense Jacobian is
+   * evaluated and multiplied.
+   */
+  void jvp(const std::vector<BaseScalar> &input,
+           const std::vector<BaseScalar> &tangent,
+           std::vector<BaseScalar> &output) override {
+    if (target_ == TARGET_CPU) {
+      assert(!library_name_.empty());
+      auto model = get_cpu_model();
+      if (model->isForwardOneAvailable()) {
+        output.resize(output_dim());
+        forward_one_(model, input.data(), tangent.data(), output.data());
+        return;
+      }
+    }
+    GeneratedBase::jvp(input, tangent, output);
+  }
+
+  /**
+   * Vector-Jacobian product via the generated first-order reverse functions,
+   * which requires the library to be compiled with
+   * `generate_directional_derivatives`. Otherwise the dense Jacobian is
+   * evaluated and multiplied.
+   */
+  void vjp(const std::vector<BaseScalar> &input,
+           const std::vector<BaseScalar> &cotangent,
+           std::vector<BaseScalar> &output) override {
+    if (target_ == TARGET_CPU) {
+      assert(!library_name_.empty());
+      auto model = get_cpu_model();
+      if (model->isReverseOneAvailable()) {
+        output.resize(input_dim());
+        reverse_one_(model, input.data(), cotangent.data(), output.data());
+        return;
+      }
+    }
+    GeneratedBase::vjp(input, cotangent, output);
+  }
+
+  void jvp(int num_samples, BatchView<const BaseScalar> local_inputs,
+           BatchView<const BaseScalar> tangents, BatchView<BaseScalar> outputs,
+           BatchView<const BaseScalar> global_input = {}) override {
+    if (target_ == TARGET_CPU && get_cpu_model()->isForwardOneAvailable()) {
+      for_each_cpu_sample_(
+          num_samples, local_inputs, global_input,
+          [&](GenericModel *model, int i, const BaseScalar *input) {
+            forward_one_(model, input, tangents[i], outputs[i]);
+          });
+      return;
+    }
+    GeneratedBase::jvp(num_samples, local_inputs, tangents, outputs,
+                       global_input);
+  }
+
+  void vjp(int num_samples, BatchView<const BaseScalar> local_inputs,
+           BatchView<const BaseScalar> cotangents,
+           BatchView<BaseScalar> outputs,
+           BatchView<const BaseScalar> global_input = {}) override {
+    if (target_ == TARGET_CPU && get_cpu_model()->isReverseOneAvailable()) {
+      for_each_cpu_sample_(
+          num_samples, local_inputs, global_input,
+          [&](GenericModel *model, int i, const BaseScalar *input) {
+            reverse_one_(model, input, cotangents[i], outputs[i]);
+          });
+      return;
+    }
+    GeneratedBase::vjp(num_samples, local_inputs, cotangents, outputs,
+                       global_input);
+  }
+
+  /**
+   * Sparsity pattern (CSR) of the Hessian of the weighted sum of the outputs
+   * with respect to the full input vector (global input followed by the local
+   * input). Requires the library to be compiled with `generate_hessian`.
+   */
+  const SparsityPattern &hessian_sparsity() const {
+    if (target_ != TARGET_CPU) {
+      throw std::runtime_error(
+          "Hessians are only supported by the CPU target.");
+    }
+    assert(!library_name_.empty());
+    load_cpu_library_if_needed_();
+    if (hessian_sparsity_.empty()) {
+      throw std::runtime_error(
+          "The sparse Hessian is not available in the library of \"" + name_ +
+          "\". Set generate_hessian before compiling the function.");
+    }
+    return hessian_sparsity_;
+  }
+
+  /**
+   * Computes the nonzero entries of the Hessian of the weighted sum of the
+   * outputs in the CSR order of `hessian_sparsity()`.
+   */
+  void sparse_hessian(const std::vector<BaseScalar> &input,
+                      const std::vector<BaseScalar> &weights,
+                      std::vector<BaseScalar> &values) const {
+    values.resize(hessian_sparsity().nnz());
+    sparse_hessian_(get_cpu_model(), input.data(), weights.data(),
+                    values.data());
+  }
+
+  /**
+   * Vectorized version of `sparse_hessian()` on contiguous buffers, where row
+   * `i` of `weights` holds the output weights of sample `i` (a stride of zero
+   * shares the weights between all samples), and each row of `values`
+   * receives the `hessian_sparsity().nnz()` nonzero entries.
+   */
+  void sparse_hessian(int num_samples, BatchView<const BaseScalar> local_inputs,
+                      BatchView<const BaseScalar> weights,
+                      BatchView<BaseScalar> values,
+                      BatchView<const BaseScalar> global_input = {}) const {
+    const int nnz = hessian_sparsity().nnz();
+    eval_sparse_hessian_(num_samples, local_inputs, weights, global_input,
+                         [&](int i, const BaseScalar *sample_values) {
+                           std::copy(sample_values, sample_values + nnz,
+                                     values[i]);
+                         });
+  }
+
+  /**
+   * Sparsity pattern (CSR) of the Jacobian with respect to the full input
+   * vector (global input followed by the local input). Requires the library
+   * to be compiled with `generate_sparse_jacobian`.
+   */
+  const SparsityPattern &jacobian_sparsity() const {
+    get_sparse_jacobian_function_();
+    return jacobian_sparsity_;
+  }
+
+  /**
+   * Computes the nonzero entries of the Jacobian in the CSR order of
+   * `jacobian_sparsity()`.
+   */
+  void sparse_jacobian(const std::vector<BaseScalar> &input,
+                       std::vector<BaseScalar> &values) const {
+    const auto &fun = get_sparse_jacobian_function_();
+    values.resize(fun.output_dim());
+    call_single_(fun.function_ptr(), input.data(), values.data());
+  }
+
+  /**
+   * Vectorized version of `sparse_jacobian()` on contiguous buffers, where
+   * each row of `values` receives the `jacobian_sparsity().nnz()` nonzero
+   * entries of the corresponding sample.
+   */
+  void sparse_jacobian(int num_samples,
+                       BatchView<const BaseScalar> local_inputs,
+                       BatchView<BaseScalar> values,
+                       BatchView<const BaseScalar> global_input = {}) const {
+    run_cpu_batch_(get_sparse_jacobian_function_(), num_samples, local_inputs,
+                   values, global_input);
+  }
+
+  /**
+   * Forward pass on `num_blocks` blocks of `simd_width` samples in
+   * structure-of-arrays layout, as created by `aos_to_soa()`. The outputs are
+   * written in the same layout. Requires the library to be compiled with
+   * `simd_width > 0`.
+   */
+  void forward_zero_soa(int num_blocks, const BaseScalar *local_inputs,
+                        BaseScalar *outputs,
+                        const BaseScalar *global_input = nullptr) const {
+    run_cpu_simd_(get_cpu_simd_function_(cpu_forward_zero_simd_), num_blocks,
+                  local_inputs, outputs, global_input);
+  }
+
+  /**
+   * Jacobian on `num_blocks` blocks of `simd_width` samples in
+   * structure-of-arrays layout, where entry `j` of the row-major Jacobian of
+   * sample `k` in block `b` is written to
+   * `outputs[(b * output_dim() * input_dim() + j) * simd_width + k]`.
+   */
+  void jacobian_soa(int num_blocks, const BaseScalar *local_inputs,
+                    BaseScalar *outputs,
+                    const BaseScalar *global_input = nullptr) const {
+    run_cpu_simd_(get_cpu_simd_function_(cpu_jacobian_simd_), num_blocks,
+                  local_inputs, outputs, global_input);
+  }
+
+  void compile_cpu() {
+    using namespace CppAD;
+    using namespace CppAD::cg;
+
+    optimize_traced_tapes();
+    setup_cpu_compiler_();
+    apply_pgo_stage_();
+    // the library is loaded from disk again
+    jit_library_ = nullptr;
+
+    std::unique_ptr<CompilationCache> cache;
+    std::string cache_key;
+    CompilationCache::Lock cache_lock;
+    if (!cache_directory.empty()) {
+      cache = std::make_unique<CompilationCache>(cache_directory);
+      cache_key = name_ + "_" + cpu_cache_key_();
+      if (!cache->contains(cache_key, library_ext_)) {
+        // another process may be compiling the same library right now
+        cache_lock = cache->lock(cache_key);
+      }
+      if (cache->contains(cache_key, library_ext_)) {
+        std::cout << "Loading \"" << name_ << "\" from the compilation cache "
+                  << cache->path(cache_key, library_ext_) << std::endl;
+        unload_cpu_library_();
+        library_name_ = cache->path(cache_key, "");
+        target_ = TARGET_CPU;
+        return;
+      }
+    }
+
+    generate_cpu_sources_([&](ModelLibraryCSourceGen<BaseScalar> &libcgen) {
+      build_cpu_library_(libcgen);
+    });
+    library_name_ = "./" + cpu_build_name();
+    target_ = TARGET_CPU;
+
+    if (cache) {
+      cache->store(cache_key, library_ext_, library_name_ + library_ext_);
+      library_name_ = cache->path(cache_key, "");
+    }
+  }
+
+  /**
+   * Compiles the CPU library with each of the compiler `variants`
+   * concurrently, checks the outputs and Jacobians of each variant on the
+   * sample `inputs` against `reference` (e.g. the CppAD tape of the
+   * function), and benchmarks the variants that pass the check on the same
+   * batch. The fastest of them is applied to this function, which is
+   * compiled with it afterwards.
+   *
+   * The winning variant is persisted in the `autotune` subdirectory of
+   * `cache_directory` (or in `./<name>_cpu_autotune` if the cache is
+   * disabled) under the hash of the operation graph, the code generation
+   * options and the compiler. Later calls for the same function apply the
+   * persisted variant without benchmarking unless `force` is true.
+   *
+   * A variant passes the check if every output and Jacobian entry deviates
+   * from the reference by at most `tolerance` relative to
+   * `max(1, |reference|)`. Each variant is benchmarked `repetitions` times on
+   * the batch, of which the fastest time is reported. Returns the results of
+   * all variants, or only the persisted variant. Not supported by the MSVC
+   * compiler.
+   */
+  std::vector<AutotuneResult> autotune(
+      const std::vector<std::vector<BaseScalar>> &inputs,
+      GeneratedBaseT<BaseScalar> &reference,
+      const std::vector<CompileVariant> &variants = CompileVariant::defaults(),
+      double tolerance = sizeof(BaseScalar) < sizeof(double) ? 1e-4 : 1e-9,
+      int repetitions = 5, bool force = false) {
+    namespace fs = std::filesystem;
+    if (inputs.empty() || variants.empty()) {
+      throw std::runtime_error("Autotuning \"" + name_ +
+                               "\" requires sample inputs and variants.");
+    }
+    setup_cpu_compiler_();
+    if (dynamic_cast<MsvcCompiler *>(cpu_compiler.get())) {
+      throw std::runtime_error(
+          "Autotuning is not supported by the MSVC compiler.");
+    }
+    optimize_traced_tapes();
+    Hasher hasher;
+    hash_cpu_model_(hasher);
+    hasher.add(cpu_compiler->getCompilerPath());
+    const fs::path root = cache_directory.empty()
+                              ? fs::path("./" + name_ + "_cpu_autotune")
+                              : fs::path(cache_directory) / "autotune";
+    const std::string config =
+        (root / (name_ + "_" + hasher.hex() + ".txt")).string();
+    AutotuneResult persisted;
+    if (!force && persisted.variant.load(config)) {
+      std::cout << "Using the autotuned variant " << persisted.variant.str()
+                << " of \"" << name_ << "\".\n";
+      apply_variant_(persisted.variant);
+      compile_cpu();
+      persisted.valid = true;
+      return {persisted};
+    }
+
+    // reference values of the sample batch
+    const int n = static_cast<int>(inputs.size());
+    const int id = input_dim();
+    const int od = output_dim();
+    std::vector<BaseScalar> flat_inputs(static_cast<std::size_t>(n) * id),
+        ref_outputs, ref_jacobians, values;
+    for (int i = 0; i < n; ++i) {
+      if (static_cast<int>(inputs[i].size()) != id) {
+        throw std::runtime_error("Sample input " + std::to_string(i) +
+                                 " of \"" + name_ + "\" has dimension " +
+                                 std::to_string(inputs[i].size()) +
+                                 " instead of " + std::to_string(id) + ".");
+      }
+      std::copy(inputs[i].begin(), inputs[i].end(),
+                flat_inputs.begin() + static_cast<std::size_t>(i) * id);
+      if (generate_forward) {
+        reference(inputs[i], values);
+        ref_outputs.insert(ref_outputs.end(), values.begin(), values.end());
+      }
+      if (generate_jacobian) {
+        reference.jacobian(inputs[i], values);
+        ref_jacobians.insert(ref_jacobians.end(), values.begin(),
+                             values.end());
+      }
+    }
+
+    // the variants are compiled concurrently, each with a share of the
+    // hardware threads for its translation units
+    const int num_threads =
+        static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const int num_variants = static_cast<int>(variants.size());
+    std::vector<AutotuneResult> results(variants.size());
+    std::vector<std::unique_ptr<GeneratedCodeGenT>> builds(variants.size());
+    std::atomic<int> next_variant{0};
+    const auto build_variants = [&]() {
+      for (int i = next_variant++; i < num_variants; i = next_variant++) {
+        results[i].variant = variants[i];
+        auto gen = std::make_unique<GeneratedCodeGenT>(main_trace_);
+        copy_cpu_options_to_(*gen);
+        gen->num_compile_jobs = std::max(1, num_threads / num_variants);
+        gen->set_cpu_build_name(cpu_build_name() + "_variant" +
+                                std::to_string(i));
+        gen->apply_variant_(variants[i]);
+        Stopwatch timer;
+        timer.start();
+        try {
+          gen->compile_cpu();
+          builds[i] = std::move(gen);
+        } catch (const std::exception &e) {
+          results[i].error = e.what();
+        }
+        timer.stop();
+        results[i].compile_time = timer.elapsed();
+      }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < std::min(num_variants, num_threads); ++t) {
+      threads.emplace_back(build_variants);
+    }
+    build_variants();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    // the variants are benchmarked one after another to not interfere
+    const int gd = global_input_dim_;
+    const BatchView<const BaseScalar> local_inputs(flat_inputs.data() + gd,
+                                                   id);
+    const BatchView<const BaseScalar> global_inputs(flat_inputs.data(), id);
+    std::vector<BaseScalar> outputs(ref_outputs.size()),
+        jacobians(ref_jacobians.size());
+    int best = -1;
+    for (int i = 0; i < num_variants; ++i) {
+      if (!builds[i]) {
+        continue;
+      }
+      GeneratedCodeGenT &gen = *builds[i];
+      AutotuneResult &result = results[i];
+      const auto run = [&]() {
+        if (generate_forward) {
+          gen(n, local_inputs, {outputs.data(), od}, global_inputs);
+        }
+        if (generate_jacobian) {
+          gen.jacobian(n, local_inputs, {jacobians.data(), od * id},
+                       global_inputs);
+        }
+      };
+      try {
+        run();
+        result.max_error =
+            std::max(relative_error_(outputs, ref_outputs),
+                     relative_error_(jacobians, ref_jacobians));
+        // also rejects NaN errors
+        if (!(result.max_error <= tolerance)) {
+          result.error = "deviates from the reference by " +
+                         std::to_string(result.max_error);
         } else {
-          static thread_local std::vector<BaseScalar> input;
-          if (input.empty()) {
-            input.resize(global_input.size());
-            input.insert(input.begin(), global_input.begin(),
-                         global_input.end());
+          result.run_time = std::numeric_limits<double>::infinity();
+          for (int r = 0; r < std::max(1, repetitions); ++r) {
+            Stopwatch timer;
+            timer.start();
+            run();
+            timer.stop();
+            result.run_time = std::min(result.run_time, timer.elapsed());
           }
-          for (size_t j = 0; j < local_inputs[i].size(); ++j) {
-            input[j + global_input.size()] = local_inputs[i][j];
+          result.valid = true;
+          if (best < 0 || result.run_time < results[best].run_time) {
+            best = i;
           }
-          auto model = get_cpu_model();
-          model->Jacobian(input, outputs[i]);
         }
+      } catch (const std::exception &e) {
+        result.error = e.what();
+      }
+      gen.discard_library();
+      // the library remains in the compilation cache if it is enabled
+      fs::remove_all(gen.cpu_build_name() + "_srcs");
+      fs::remove_all(gen.cpu_build_name() + "_tmp");
+      fs::remove("./" + gen.cpu_build_name() + library_ext_);
+    }
+
+    std::cout << "Autotuning results of \"" << name_ << "\":\n";
+    for (int i = 0; i < num_variants; ++i) {
+      const AutotuneResult &result = results[i];
+      std::cout << (i == best ? " * " : "   ") << result.variant.str()
+                << ": compiled in " << result.compile_time << " s, ";
+      if (result.valid) {
+        std::cout << "evaluated in " << result.run_time << " s\n";
+      } else {
+        std::cout << "rejected (" << result.error << ")\n";
       }
-    } else if (target_ == TARGET_CUDA) {
-      const auto &model = get_cuda_model();
-      model.jacobian(&outputs, local_inputs, num_gpu_threads_per_block,
-                     global_input);
     }
+    if (best < 0) {
+      throw std::runtime_error("None of the variants of \"" + name_ +
+                               "\" passed the autotuning.");
+    }
+    fs::create_directories(root);
+    results[best].variant.save(config);
+    apply_variant_(results[best].variant);
+    compile_cpu();
+    return results;
   }
 
-  void compile_cpu() {
+  /**
+   * Compiles the CPU library in memory via the LLVM model library processor
+   * of CppADCodeGen (which runs Clang and the LLVM JIT in-process), so that
+   * neither source files nor a shared library are written to disk and no
+   * compiler process is spawned. The compiled library provides the same
+   * functions as the one of `compile_cpu()`. Requires autogen to be built
+   * with `AUTOGEN_USE_LLVM`.
+   */
+  void compile_jit() {
+#if AUTOGEN_USE_LLVM
+    using namespace CppAD::cg;
+    optimize_traced_tapes();
+    Stopwatch timer;
+    timer.start();
+    generate_cpu_sources_([&](ModelLibraryCSourceGen<BaseScalar> &libcgen) {
+      LlvmModelLibraryProcessor<BaseScalar> p(libcgen);
+      if (!jit_include_paths.empty()) {
+        p.setIncludePaths(jit_include_paths);
+      }
+      std::unique_lock<std::mutex> lock(source_generation_mutex_);
+      std::unique_ptr<LlvmModelLibrary<BaseScalar>> library = p.create();
+      lock.unlock();
+      unload_cpu_library_();
+      jit_library_ = std::move(library);
+    });
+    // the library only exists in memory
+    library_name_ = name_ + "_jit";
+    target_ = TARGET_CPU;
+    timer.stop();
+    std::cout << "Compiled \"" << name_ << "\" in memory in "
+              << timer.elapsed() << " s.\n";
+#else
+    throw std::runtime_error(
+        "Cannot compile \"" + name_ +
+        "\" via the LLVM JIT since autogen has been built without "
+        "AUTOGEN_USE_LLVM.");
+#endif
+  }
+  /**
+   * Exports the batched entry points of the function (see `generate_batch`)
+   * as a self-contained C source bundle in `directory`, so that other
+   * projects can call the generated code directly instead of loading a
+   * shared library at runtime:
+   *
+   * - `<name>_inline.h` contains the complete code, where all entry points are
+   *   `static inline` so that the compiler can inline them into the caller,
+   * - `<name>.h` declares the entry points with C linkage, and `<name>.c`
+   *   defines them by compiling the inline header once,
+   * - `CMakeLists.txt` defines the static library target `<name>` and the
+   *   header-only target `<name>_inline`, which downstream projects link
+   *   after adding the directory via `add_subdirectory()`.
+   *
+   * Single samples are evaluated by passing `num_samples = 1`. If
+   * `build_static_library` is true, `<name>.c` is also compiled into
+   * `lib<name>.a` with the executable and flags of `cpu_compiler` and the
+   * archiver `ar` (not supported by the MSVC compiler). SIMD functions (see
+   * `simd_width`) are not exported.
+   */
+  void export_cpu(const std::string &directory,
+                  bool build_static_library = false) {
+    namespace fs = std::filesystem;
+    std::string macro = name_;
+    for (char &c : macro) {
+      c = std::isalnum(static_cast<unsigned char>(c))
+              ? static_cast<char>(std::toupper(static_cast<unsigned char>(c)))
+              : '_';
+    }
+    const std::string api = "AUTOGEN_" + macro + "_API";
+    std::string declarations;
+    const std::string source = generate_batch_source_(api, &declarations);
+
+    fs::create_directories(directory);
+    const fs::path dir(directory);
+    const std::string inline_header = name_ + "_inline.h";
+    const std::string header = name_ + ".h";
+    const std::string source_file = (dir / (name_ + ".c")).string();
+    write_file_((dir / inline_header).string(),
+                "#ifndef " + macro + "_INLINE_H\n#define " + macro +
+                    "_INLINE_H\n\n" + source + "\n#endif\n");
+    write_file_((dir / header).string(),
+                "#ifndef " + macro + "_H\n#define " + macro + "_H\n\n" +
+                    cpu_export_meta_data() +
+                    "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n" +
+                    declarations +
+                    "#ifdef __cplusplus\n}\n#endif\n\n#endif\n");
+    write_file_(source_file,
+                "/* external definitions of the functions in " + header +
+                    " */\n#define " + api + "\n#include \"" + header +
+                    "\"\n#include \"" + inline_header + "\"\n");
+    write_file_(
+        (dir / "CMakeLists.txt").string(),
+        "cmake_minimum_required(VERSION 3.13)\nproject(" + name_ +
+            " C)\n\n"
+            "add_library(" + name_ + " STATIC " + name_ + ".c)\n"
+            "set_target_properties(" + name_ +
+            " PROPERTIES POSITION_INDEPENDENT_CODE ON)\n"
+            "target_include_directories(" + name_ +
+            " PUBLIC ${CMAKE_CURRENT_SOURCE_DIR})\n\n"
+            "add_library(" + name_ + "_inline INTERFACE)\n"
+            "target_include_directories(" + name_ +
+            "_inline INTERFACE ${CMAKE_CURRENT_SOURCE_DIR})\n\n"
+            "if(UNIX)\n"
+            "  target_link_libraries(" + name_ + " PUBLIC m)\n"
+            "  target_link_libraries(" + name_ + "_inline INTERFACE m)\n"
+            "endif()\n");
+    std::cout << "Exported \"" << name_ << "\" to " << dir << ".\n";
+
+    if (build_static_library) {
+      setup_cpu_compiler_();
+      if (dynamic_cast<MsvcCompiler *>(cpu_compiler.get())) {
+        throw std::runtime_error(
+            "Static libraries of exported functions cannot be built with the "
+            "MSVC compiler, use the exported CMakeLists.txt instead.");
+      }
+      const std::string object = (dir / (name_ + ".o")).string();
+      std::vector<std::string> args = cpu_compiler->getCompileFlags();
+      args.insert(args.end(), {"-c", "-fPIC", source_file, "-o", object});
+      exec(cpu_compiler->getCompilerPath(), args);
+      const std::string library = (dir / ("lib" + name_ + ".a")).string();
+      // `ar` would add the object to an existing archive
+      fs::remove(library);
+      exec(find_exe("ar"), {"rcs", library, object});
+      std::cout << "Built the static library " << library << ".\n";
+    }
+  }
+
+ protected:
+  /**
+   * Compiles the sources of `libcgen` into the shared library
+   * `./<name>_cpu`.
+   */
+  void build_cpu_library_(
+      CppAD::cg::ModelLibraryCSourceGen<BaseScalar> &libcgen) {
+    using namespace CppAD::cg;
+    // a previously loaded library must be closed before it is overwritten
+    unload_cpu_library_();
+    const int num_jobs = num_compile_jobs > 0
+                             ? num_compile_jobs
+                             : static_cast<int>(std::max(
+                                   1u, std::thread::hardware_concurrency()));
+    if ((num_jobs > 1 || incremental_compilation) &&
+        !dynamic_cast<MsvcCompiler *>(cpu_compiler.get())) {
+      compile_cpu_parallel_(libcgen, num_jobs);
+    } else {
+      DynamicModelLibraryProcessor<BaseScalar> p(libcgen);
+      p.setLibraryName(cpu_build_name());
+      bool load_library = false;  // we do this in another step
+      std::lock_guard<std::mutex> lock(source_generation_mutex_);
+      p.createDynamicLibrary(*cpu_compiler, load_library);
+    }
+  }
+
+  /**
+   * Generates the sources of the main model, its atomic functions and the
+   * batch and SIMD functions, and passes the library source generator that
+   * holds them to `process`.
+   */
+  template <typename Process>
+  void generate_cpu_sources_(Process process) {
     using namespace CppAD;
     using namespace CppAD::cg;
 
+    // the sources of the models are generated lazily by `process`, which
+    // locks the mutex itself
+    std::unique_lock<std::mutex> lock(source_generation_mutex_);
     ModelCSourceGen<BaseScalar> main_source_gen(*(main_trace_.tape), name_);
     main_source_gen.setCreateForwardZero(generate_forward);
     main_source_gen.setCreateJacobian(generate_jacobian);
+    main_source_gen.setCreateSparseHessian(generate_hessian);
+    main_source_gen.setCreateForwardOne(generate_directional_derivatives);
+    main_source_gen.setCreateReverseOne(generate_directional_derivatives);
+    main_source_gen.setMaxAssignmentsPerFunc(max_assignments_per_function);
     ModelLibraryCSourceGen<BaseScalar> libcgen(main_source_gen);
     // reverse order of invocation to first generate code for innermost
     // functions
@@ -303,14 +1447,97 @@ class GeneratedCodeGen : public GeneratedBase {
       // source_gen->setCreateJacobian(generate_jacobian);
       source_gen->setCreateForwardOne(generate_jacobian);
       source_gen->setCreateReverseOne(generate_jacobian);
+      // second-order sweeps through atomic functions
+      source_gen->setCreateReverseTwo(generate_hessian);
+      source_gen->setCreateHessianSparsityByEquation(generate_hessian);
+      source_gen->setMaxAssignmentsPerFunc(max_assignments_per_function);
       models.push_back(source_gen);
       // we need a stable reference
       libcgen.addModel(*(models.back()));
     }
     libcgen.setVerbose(true);
 
-    DynamicModelLibraryProcessor<BaseScalar> p(libcgen);
+    if (generate_batch) {
+      libcgen.addCustomFunctionSource(name_ + "_batch.c",
+                                      generate_batch_source_());
+    }
+    if (simd_width > 0) {
+      if (!order.empty()) {
+        std::cerr << "Warning: SIMD functions are not generated for \""
+                  << name_ << "\" since it calls atomic functions.\n";
+      } else {
+        CpuSimdSourceGen<BaseScalar> simd_gen(*(main_trace_.tape), name_,
+                                              simd_width);
+        simd_gen.global_input_dim() = global_input_dim_;
+        std::string source = cpu_source_prelude(simd_gen.base_type_name());
+        if (generate_forward) {
+          source += simd_gen.forward_zero_source();
+        }
+        if (generate_jacobian) {
+          source += simd_gen.jacobian_source();
+        }
+        libcgen.addCustomFunctionSource(name_ + "_simd.c", source);
+      }
+    }
+
+    lock.unlock();
+    process(libcgen);
+    for (auto *model : models) {
+      delete model;
+    }
+  }
+
+  /**
+   * Generates the batch functions of the main model (and the per-sample
+   * functions of its atomic functions) as a single C source. If `export_api`
+   * is empty, the source is compiled into the CPU library, otherwise it is
+   * the body of an exported header whose entry points are declared via the
+   * macro `export_api` (see `export_cpu()`). The C declarations of the entry
+   * points are written to `declarations` if it is not null.
+   */
+  std::string generate_batch_source_(
+      const std::string &export_api = "",
+      std::string *declarations = nullptr) const {
+    using namespace CppAD::cg;
+    const auto &order = *CodeGenData<BaseScalar>::invocation_order;
+    std::list<std::unique_ptr<CudaModelSourceGen<BaseScalar>>> batch_models;
+    batch_models.push_back(std::make_unique<CudaModelSourceGen<BaseScalar>>(
+        *(main_trace_.tape), name_));
+    auto *batch_main = batch_models.back().get();
+    batch_main->setCreateForwardZero(generate_forward);
+    batch_main->setCreateJacobian(generate_jacobian);
+    batch_main->set_create_value_and_jacobian(generate_value_and_jacobian &&
+                                              generate_jacobian);
+    batch_main->global_input_dim() = global_input_dim_;
+    CpuBatchSourceGen<BaseScalar> batch_gen(batch_main);
+    if (generate_sparse_jacobian) {
+      SparsityPattern pattern = autogen::jacobian_sparsity(*(main_trace_.tape));
+      std::cout << "Jacobian of \"" << name_ << "\" has " << pattern.nnz()
+                << " nonzero entries out of "
+                << pattern.num_rows * pattern.num_cols << ".\n";
+      batch_gen.set_jacobian_sparsity(pattern);
+    }
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      FunctionTrace<BaseScalar> &trace =
+          (*CodeGenData<BaseScalar>::traces)[*it];
+      batch_models.push_back(std::make_unique<CudaModelSourceGen<BaseScalar>>(
+          *(trace.tape), *it));
+      batch_models.back()->setCreateForwardOne(generate_jacobian);
+      batch_models.back()->setCreateReverseOne(generate_jacobian);
+      batch_gen.add_model(batch_models.back().get());
+    }
+    if (declarations) {
+      *declarations = batch_gen.generate_declarations();
+    }
+    if (export_api.empty()) {
+      return batch_gen.generate_code();
+    }
+    return batch_gen.generate_code(
+               cpu_export_prelude(batch_main->base_type_name(), export_api)) +
+           cpu_export_epilogue();
+  }
 
+  void setup_cpu_compiler_() {
     // if (clang_path.empty()) {
     //   clang_path = autogen::find_exe("clang", false);
     // }
@@ -328,79 +1555,472 @@ class GeneratedCodeGen : public GeneratedBase {
       set_cpu_compiler_clang();
 #endif
     }
-    cpu_compiler->setSourcesFolder(name_ + "_cpu_srcs");
-    cpu_compiler->setTemporaryFolder(name_ + "_cpu_tmp");
+    cpu_compiler->setSourcesFolder(cpu_build_name() + "_srcs");
+    cpu_compiler->setTemporaryFolder(cpu_build_name() + "_tmp");
     cpu_compiler->setSaveToDiskFirst(true);
+    // flags are only added once, so that recompilations within the same
+    // process produce the same compilation cache key
+    const auto add_flag = [this](const std::string &flag) {
+      const auto &flags = cpu_compiler->getCompileFlags();
+      if (std::find(flags.begin(), flags.end(), flag) == flags.end()) {
+        cpu_compiler->addCompileFlag(flag);
+      }
+    };
+    if (simd_width > 0 && !dynamic_cast<MsvcCompiler *>(cpu_compiler.get())) {
+      // enables `#pragma omp simd` without linking the OpenMP runtime
+      add_flag("-fopenmp-simd");
+    }
+    // replaces the optimization level of a previous compilation
+    const std::string level =
+        debug_mode ? "-O0" : "-O" + std::to_string(optimization_level);
+    std::vector<std::string> flags = cpu_compiler->getCompileFlags();
+    flags.erase(std::remove_if(flags.begin(), flags.end(),
+                               [&level](const std::string &flag) {
+                                 return flag.rfind("-O", 0) == 0 &&
+                                        flag != level;
+                               }),
+                flags.end());
+    cpu_compiler->setCompileFlags(flags);
     if (debug_mode) {
-      cpu_compiler->addCompileFlag("-g");
-      cpu_compiler->addCompileFlag("-O0");
-    } else {
-      cpu_compiler->addCompileFlag("-O" + std::to_string(optimization_level));
+      add_flag("-g");
     }
-    p.setLibraryName(name_ + "_cpu");
-    bool load_library = false;  // we do this in another step
-    p.createDynamicLibrary(*cpu_compiler, load_library);
-    library_name_ = "./" + name_ + "_cpu";
-    target_ = TARGET_CPU;
+    add_flag(level);
   }
 
-  mutable std::mutex cpu_library_loading_mutex_{};
+  /**
+   * Compiles every C source file of the library into its own object file
+   * using `num_jobs` concurrent compiler processes, and links the objects
+   * into the shared library `./<name>_cpu` afterwards. Uses the executable
+   * and flags of `cpu_compiler`. Sources whose object file is found in the
+   * object cache (see `incremental_compilation`) are not compiled again.
+   */
+  void compile_cpu_parallel_(
+      CppAD::cg::ModelLibraryCSourceGen<BaseScalar> &libcgen, int num_jobs) {
+    namespace fs = std::filesystem;
+    Stopwatch timer;
+    timer.start();
+    const std::string sources_folder = cpu_compiler->getSourcesFolder();
+    const std::string objects_folder = cpu_compiler->getTemporaryFolder();
+    // sources of a previous compilation may have been split differently
+    fs::remove_all(sources_folder);
+    {
+      std::lock_guard<std::mutex> lock(source_generation_mutex_);
+      CppAD::cg::SaveFilesModelLibraryProcessor<BaseScalar> saver(libcgen);
+      saver.saveSourcesTo(sources_folder);
+    }
+    fs::create_directories(objects_folder);
 
-  GenericModelPtr get_cpu_model() const {
-    if (!cpu_library_) {
-      cpu_library_loading_mutex_.lock();
-      cpu_library_ = std::make_shared<DynamicLib>(library_name_ + library_ext_);
-      std::set<std::string> model_names = cpu_library_->getModelNames();
-      std::cout << "Successfully loaded CPU library "
-                << library_name_ + library_ext_ << std::endl;
-      for (auto &name : model_names) {
-        std::cout << "  Found model " << name << std::endl;
-      }
-      // load and wire up atomic functions in this library
-      const auto &order = *CodeGenData<BaseScalar>::invocation_order;
-      const auto &hierarchy = CodeGenData<BaseScalar>::call_hierarchy;
-      cpu_models_[name_] =
-          GenericModelPtr(cpu_library_->model(name_).release());
-      if (!cpu_models_[name_]) {
-        throw std::runtime_error("Failed to load model from library " +
-                                 library_name_ + library_ext_);
-      }
-      // atomic functions to be added
-      typedef std::pair<std::string, std::string> ParentChild;
-      std::set<ParentChild> remaining_atomics;
-      for (const std::string &s :
-           cpu_models_[name_]->getAtomicFunctionNames()) {
-        remaining_atomics.insert(std::make_pair(name_, s));
-      }
-      while (!remaining_atomics.empty()) {
-        ParentChild member = *(remaining_atomics.begin());
-        const std::string &parent = member.first;
-        const std::string &atomic_name = member.second;
-        remaining_atomics.erase(remaining_atomics.begin());
-        if (cpu_models_.find(atomic_name) == cpu_models_.end()) {
-          std::cout << "  Adding atomic function " << atomic_name << std::endl;
-          cpu_models_[atomic_name] =
-              GenericModelPtr(cpu_library_->model(atomic_name).release());
-          for (const std::string &s :
-               cpu_models_[atomic_name]->getAtomicFunctionNames()) {
-            remaining_atomics.insert(std::make_pair(atomic_name, s));
+    const std::string compiler = cpu_compiler->getCompilerPath();
+    // everything an object file depends on besides its own source
+    Hasher settings;
+    settings.add(compiler);
+    for (const auto &flag : cpu_compiler->getCompileFlags()) {
+      settings.add(flag);
+    }
+    settings.add(profile_hash_);
+    std::vector<std::string> all_sources, sources, objects, linked_objects,
+        cache_keys;
+    for (const auto &entry : fs::directory_iterator(sources_folder)) {
+      all_sources.push_back(entry.path().string());
+    }
+    std::sort(all_sources.begin(), all_sources.end());
+    for (const auto &file : all_sources) {
+      if (fs::path(file).extension() != ".c") {
+        // headers that may be included by the sources
+        settings.add(fs::path(file).filename().string()).add(read_file_(file));
+      }
+    }
+
+    std::unique_ptr<CompilationCache> object_cache;
+    if (incremental_compilation) {
+      object_cache = std::make_unique<CompilationCache>(
+          (fs::path(cache_directory.empty() ? objects_folder
+                                            : cache_directory) /
+           "objects")
+              .string());
+    }
+    for (const auto &file : all_sources) {
+      const fs::path source(file);
+      if (source.extension() != ".c") {
+        continue;
+      }
+      const std::string object =
+          (fs::path(objects_folder) / source.filename())
+              .replace_extension(".o")
+              .string();
+      if (object_cache) {
+        Hasher hasher = settings;
+        const std::string key = source.stem().string() + "_" +
+                                hasher.add(read_file_(file)).hex();
+        linked_objects.push_back(object_cache->path(key, ".o"));
+        if (object_cache->contains(key, ".o")) {
+          continue;
+        }
+        cache_keys.push_back(key);
+      } else {
+        linked_objects.push_back(object);
+      }
+      sources.push_back(file);
+      objects.push_back(object);
+    }
+    std::cout << "Compiling " << sources.size() << " of "
+              << linked_objects.size() << " translation units of \"" << name_
+              << "\" with " << std::min<std::size_t>(num_jobs, sources.size())
+              << " jobs...\n";
+
+    std::atomic<std::size_t> next_source{0};
+    std::mutex error_mutex;
+    std::exception_ptr error{nullptr};
+    const auto compile_sources = [&]() {
+      for (std::size_t i = next_source++; i < sources.size();
+           i = next_source++) {
+        std::vector<std::string> args = cpu_compiler->getCompileFlags();
+        args.insert(args.end(),
+                    {"-c", "-fPIC", sources[i], "-o", objects[i]});
+        try {
+          exec(compiler, args);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (!error) {
+            error = std::current_exception();
           }
+          return;
+        }
+      }
+    };
+    std::vector<std::thread> jobs;
+    for (std::size_t j = 1;
+         j < std::min<std::size_t>(num_jobs, sources.size()); ++j) {
+      jobs.emplace_back(compile_sources);
+    }
+    compile_sources();
+    for (auto &job : jobs) {
+      job.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    for (std::size_t i = 0; i < cache_keys.size(); ++i) {
+      object_cache->store(cache_keys[i], ".o", objects[i]);
+    }
+    const double compile_time = timer.elapsed();
+
+    std::vector<std::string> args = cpu_compiler->getCompileLibFlags();
+    args.insert(args.end(), linked_objects.begin(), linked_objects.end());
+    args.push_back("-o");
+    args.push_back("./" + cpu_build_name() + library_ext_);
+    exec(compiler, args);
+    timer.stop();
+    std::cout << "Compiled \"" << name_ << "\" in " << compile_time
+              << " s and linked it in " << timer.elapsed() - compile_time
+              << " s.\n";
+  }
+
+  static std::string read_file_(const std::string &filename) {
+    std::ifstream file(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+  }
+
+  static void write_file_(const std::string &filename,
+                          const std::string &content) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Failed to write \"" + filename + "\".");
+    }
+    file << content;
+  }
+
+  /**
+   * Hash of everything the compiled CPU library depends on: the operation
+   * graphs of the main function and its atomic functions, the options that
+   * affect the generated code, and the compiler with its flags. Unless
+   * `with_profile` is false, this includes the profile-guided optimization
+   * flags and the contents of the used profile.
+   */
+  std::string cpu_cache_key_(bool with_profile = true) const {
+    Hasher hasher;
+    hash_cpu_model_(hasher);
+    hasher.add(max_assignments_per_function);
+    hasher.add(cpu_compiler->getCompilerPath());
+    for (const auto &flag : cpu_compiler->getCompileFlags()) {
+      if (with_profile || !is_profile_flag_(flag)) {
+        hasher.add(flag);
+      }
+    }
+    for (const auto &flag : cpu_compiler->getCompileLibFlags()) {
+      if (with_profile || !is_profile_flag_(flag)) {
+        hasher.add(flag);
+      }
+    }
+    if (with_profile) {
+      hasher.add(profile_hash_);
+    }
+    return hasher.hex();
+  }
+
+  /**
+   * Hashes the operation graphs of the main function and its atomic
+   * functions together with the options that affect the generated code.
+   */
+  void hash_cpu_model_(Hasher &hasher) const {
+    // hashing evaluates the tapes
+    std::lock_guard<std::mutex> lock(source_generation_mutex_);
+    hasher.add(std::string(AUTOGEN_VERSION)).add(sizeof(BaseScalar));
+    hasher.add(name_);
+    hash_operation_graph(*(main_trace_.tape), hasher);
+    const auto &order = *CodeGenData<BaseScalar>::invocation_order;
+    hasher.add(order.size());
+    for (const auto &name : order) {
+      hasher.add(name);
+      hash_operation_graph(*((*CodeGenData<BaseScalar>::traces)[name].tape),
+                           hasher);
+    }
+    const auto &hierarchy = CodeGenData<BaseScalar>::call_hierarchy;
+    for (const auto &[caller, callees] : hierarchy) {
+      hasher.add(caller).add(callees.size());
+      for (const auto &callee : callees) {
+        hasher.add(callee);
+      }
+    }
+    hasher.add(generate_forward)
+        .add(generate_jacobian)
+        .add(generate_batch)
+        .add(generate_value_and_jacobian)
+        .add(generate_sparse_jacobian)
+        .add(generate_hessian)
+        .add(generate_directional_derivatives)
+        .add(simd_width)
+        .add(global_input_dim_);
+  }
+
+  /**
+   * Sets the optimization level, the additional compiler flags and the
+   * function splitting of `variant`, replacing those of a previously applied
+   * variant.
+   */
+  void apply_variant_(const CompileVariant &variant) {
+    setup_cpu_compiler_();
+    std::vector<std::string> flags = cpu_compiler->getCompileFlags();
+    for (const auto &flag : variant_flags_) {
+      flags.erase(std::remove(flags.begin(), flags.end(), flag), flags.end());
+    }
+    for (const auto &flag : variant.flags) {
+      if (std::find(flags.begin(), flags.end(), flag) == flags.end()) {
+        flags.push_back(flag);
+      }
+    }
+    cpu_compiler->setCompileFlags(flags);
+    variant_flags_ = variant.flags;
+    optimization_level = variant.optimization_level;
+    max_assignments_per_function = variant.max_assignments_per_function;
+  }
+
+  /**
+   * Sets up `other` to compile the same CPU library as this function, with
+   * a compiler of the same kind that does not carry the flags of an applied
+   * variant or of the profile-guided optimization.
+   */
+  void copy_cpu_options_to_(GeneratedCodeGenT &other) const {
+    other.debug_mode = debug_mode;
+    other.optimization_level = optimization_level;
+    other.generate_forward = generate_forward;
+    other.generate_jacobian = generate_jacobian;
+    other.generate_batch = generate_batch;
+    other.generate_value_and_jacobian = generate_value_and_jacobian;
+    other.generate_sparse_jacobian = generate_sparse_jacobian;
+    other.generate_hessian = generate_hessian;
+    other.generate_directional_derivatives = generate_directional_derivatives;
+    other.simd_width = simd_width;
+    other.call_function_pointers = call_function_pointers;
+    other.cache_directory = cache_directory;
+    other.incremental_compilation = incremental_compilation;
+    other.optimize_tapes = optimize_tapes;
+    other.tape_optimization = tape_optimization;
+    other.tapes_optimized_ = tapes_optimized_;
+    other.max_assignments_per_function = max_assignments_per_function;
+    other.batch_chunk_size = batch_chunk_size;
+    other.thread_pool_ = thread_pool_;
+    other.jac_acc_method_ = jac_acc_method_;
+    other.global_input_dim_ = global_input_dim_;
+    other.local_input_dim_ = local_input_dim_;
+    other.output_dim_ = output_dim_;
+
+    const auto is_own_flag = [this](const std::string &flag) {
+      return is_profile_flag_(flag) ||
+             std::find(variant_flags_.begin(), variant_flags_.end(), flag) !=
+                 variant_flags_.end();
+    };
+    std::vector<std::string> flags = cpu_compiler->getCompileFlags();
+    flags.erase(std::remove_if(flags.begin(), flags.end(), is_own_flag),
+                flags.end());
+    std::vector<std::string> lib_flags = cpu_compiler->getCompileLibFlags();
+    lib_flags.erase(
+        std::remove_if(lib_flags.begin(), lib_flags.end(), is_own_flag),
+        lib_flags.end());
+    if (dynamic_cast<GccCompiler *>(cpu_compiler.get())) {
+      other.set_cpu_compiler_gcc(cpu_compiler->getCompilerPath());
+    } else {
+      other.set_cpu_compiler_clang(cpu_compiler->getCompilerPath());
+    }
+    other.cpu_compiler->setCompileFlags(flags);
+    other.cpu_compiler->setCompileLibFlags(lib_flags);
+  }
+
+  // largest deviation of `values` from `reference` relative to
+  // max(1, |reference|)
+  static double relative_error_(const std::vector<BaseScalar> &values,
+                                const std::vector<BaseScalar> &reference) {
+    double error = 0;
+    for (std::size_t i = 0; i < reference.size(); ++i) {
+      const double ref = static_cast<double>(reference[i]);
+      const double diff =
+          std::abs(static_cast<double>(values[i]) - ref) /
+          std::max(1.0, std::abs(ref));
+      // NaN outputs make the error NaN as well
+      if (!(diff <= error)) {
+        error = diff;
+      }
+    }
+    return error;
+  }
+
+  static bool is_profile_flag_(const std::string &flag) {
+    return flag.rfind("-fprofile-", 0) == 0;
+  }
+
+  /**
+   * Replaces the profile-guided optimization flags of a previous compilation
+   * by the ones of `pgo_stage`.
+   */
+  void apply_pgo_stage_() {
+    std::vector<std::string> flags = cpu_compiler->getCompileFlags();
+    flags.erase(std::remove_if(flags.begin(), flags.end(), is_profile_flag_),
+                flags.end());
+    cpu_compiler->setCompileFlags(flags);
+    std::vector<std::string> lib_flags = cpu_compiler->getCompileLibFlags();
+    lib_flags.erase(
+        std::remove_if(lib_flags.begin(), lib_flags.end(), is_profile_flag_),
+        lib_flags.end());
+    cpu_compiler->setCompileLibFlags(lib_flags);
+    profile_hash_.clear();
+    if (pgo_stage == PGO_NONE) {
+      return;
+    }
+    if (dynamic_cast<MsvcCompiler *>(cpu_compiler.get())) {
+      throw std::runtime_error(
+          "Profile-guided optimization is not supported by the MSVC "
+          "compiler.");
+    }
+    const std::string directory = profile_directory();
+    std::filesystem::create_directories(directory);
+    if (pgo_stage == PGO_INSTRUMENT) {
+      // the profiling runtime has to be linked into the library as well
+      cpu_compiler->addCompileFlag("-fprofile-generate=" + directory);
+      cpu_compiler->addCompileLibFlag("-fprofile-generate=" + directory);
+      return;
+    }
+    cpu_compiler->addCompileFlag("-fprofile-use=" +
+                                 prepare_profile_(directory));
+  }
+
+  /**
+   * Returns the profile in `directory` that is passed to `-fprofile-use`, and
+   * sets `profile_hash_` to the hash of its contents. The raw profiles
+   * written by libraries compiled with Clang are merged into
+   * `<name>.profdata`, while GCC reads the `.gcda` files from the directory
+   * itself.
+   */
+  std::string prepare_profile_(const std::string &directory) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> files, raw_profiles;
+    for (const auto &entry : fs::recursive_directory_iterator(directory)) {
+      if (!entry.is_regular_file()) {
+        continue;
+      }
+      files.push_back(entry.path().string());
+      if (entry.path().extension() == ".profraw") {
+        raw_profiles.push_back(entry.path().string());
+      }
+    }
+    std::sort(files.begin(), files.end());
+    std::sort(raw_profiles.begin(), raw_profiles.end());
+    const std::string missing =
+        "No profile of \"" + name_ + "\" has been recorded in \"" +
+        directory +
+        "\". Compile it with PGO_INSTRUMENT and evaluate a representative "
+        "workload first.";
+
+    Hasher hasher;
+    if (dynamic_cast<ClangCompiler *>(cpu_compiler.get())) {
+      const std::string profile =
+          (fs::path(directory) / (name_ + ".profdata")).string();
+      if (!raw_profiles.empty()) {
+        // merges the new runs into the existing profile
+        const std::string merged = profile + ".tmp";
+        std::vector<std::string> args{"merge", "-o", merged};
+        if (fs::exists(profile)) {
+          args.push_back(profile);
         }
-        auto &atomic_model = cpu_models_[atomic_name];
-        cpu_models_[parent]->addAtomicFunction(atomic_model->asAtomic());
+        args.insert(args.end(), raw_profiles.begin(), raw_profiles.end());
+        exec(find_exe("llvm-profdata"), args);
+        fs::rename(merged, profile);
+        for (const auto &raw_profile : raw_profiles) {
+          fs::remove(raw_profile);
+        }
+      }
+      if (!fs::exists(profile)) {
+        throw std::runtime_error(missing);
+      }
+      profile_hash_ = hasher.add(read_file_(profile)).hex();
+      return profile;
+    }
+    bool found = false;
+    for (const auto &file : files) {
+      if (fs::path(file).extension() == ".gcda") {
+        hasher.add(file).add(read_file_(file));
+        found = true;
       }
+    }
+    if (!found) {
+      throw std::runtime_error(missing);
+    }
+    profile_hash_ = hasher.hex();
+    return directory;
+  }
 
-      std::cout << "Loaded compiled model \"" << name_ << "\" from \""
-                << library_name_ << "\".\n";
-      cpu_library_loading_mutex_.unlock();
+ public:
+  /**
+   * Returns the instance of the compiled CPU model that belongs to the calling
+   * thread. Every worker of the thread pool and every other calling thread
+   * gets its own instance (with its own atomic function models), since the
+   * work buffers of a model must not be shared between threads.
+   */
+  GenericModel *get_cpu_model() const {
+    load_cpu_library_if_needed_();
+    const int worker = cpu_instances_pool_->worker_index();
+    if (worker >= 0) {
+      return cpu_worker_instances_[worker]->model;
+    }
+    // threads outside the pool cache the instance of the library they used
+    // last
+    struct CachedInstance {
+      std::uint64_t library_id{0};
+      GenericModel *model{nullptr};
+    };
+    static thread_local CachedInstance cache;
+    if (cache.library_id != cpu_library_id_) {
+      cache.model = get_thread_instance_();
+      cache.library_id = cpu_library_id_;
     }
-    return cpu_models_[name_];
+    return cache.model;
   }
 
   void compile_cuda() {
     using namespace CppAD;
     using namespace CppAD::cg;
 
+    optimize_traced_tapes();
     std::cout << "Compiling CUDA code...\n";
 
     std::cout << "Invocation order: ";
@@ -452,6 +2072,422 @@ class GeneratedCodeGen : public GeneratedBase {
     return cuda_library_->get_model(name_);
   }
 
+ protected:
+  void prepare_batch_(const std::vector<std::vector<BaseScalar>> &local_inputs,
+                      const std::vector<BaseScalar> &global_input) override {
+    // the compiled CPU model receives the concatenated input, so the input
+    // split can change without having to recompile the library (only written
+    // on a change, so that concurrent batches with the same split only read)
+    const int global_input_dim = static_cast<int>(global_input.size());
+    if (global_input_dim != global_input_dim_) {
+      global_input_dim_ = global_input_dim;
+      local_input_dim_ =
+          static_cast<int>(main_trace_.tape->Domain()) - global_input_dim;
+    }
+  }
+
+  void to_nested_(int num_samples, BatchView<const BaseScalar> local_inputs,
+                  BatchView<const BaseScalar> global_input,
+                  std::vector<std::vector<BaseScalar>> &local_vec,
+                  std::vector<BaseScalar> &global_vec) const {
+    if (global_input_dim() > 0 && global_input.stride != 0 &&
+        num_samples > 1) {
+      // the CUDA kernels broadcast a single global input over the batch
+      throw std::runtime_error(
+          "The CUDA target of \"" + name_ +
+          "\" only supports a global input that is shared by all samples "
+          "(a global input stride of zero).");
+    }
+    const int ld = local_input_dim();
+    local_vec.resize(num_samples);
+    for (int i = 0; i < num_samples; ++i) {
+      local_vec[i].assign(local_inputs[i], local_inputs[i] + ld);
+    }
+    if (global_input_dim() > 0) {
+      global_vec.assign(global_input[0], global_input[0] + global_input_dim());
+    }
+  }
+
+  /**
+   * Evaluates a batched CPU function by distributing contiguous chunks of the
+   * batch over the thread pool.
+   */
+  void run_cpu_batch_(const CpuBatchFunction<BaseScalar> &fun, int num_samples,
+                      BatchView<const BaseScalar> local_inputs,
+                      BatchView<BaseScalar> outputs,
+                      BatchView<const BaseScalar> global_input) const {
+    thread_pool()->parallel_for(
+        num_samples, batch_chunk_size, [&](int begin, int end) {
+          fun(end - begin, {local_inputs[begin], local_inputs.stride},
+              {outputs[begin], outputs.stride},
+              {global_input[begin], global_input.stride});
+        });
+  }
+
+  // evaluates the sparse Hessian of a single sample into CSR order
+  void sparse_hessian_(GenericModel *model, const BaseScalar *input,
+                       const BaseScalar *weights, BaseScalar *values) const {
+    using CppAD::cg::ArrayView;
+    const std::size_t n = input_dim();
+    const std::size_t nnz = hessian_sparsity_.nnz();
+    const std::size_t *rows, *cols;
+    if (hessian_permutation_.empty()) {
+      model->SparseHessian(ArrayView<const BaseScalar>(input, n),
+                           ArrayView<const BaseScalar>(weights, output_dim()),
+                           ArrayView<BaseScalar>(values, nnz), &rows, &cols);
+      return;
+    }
+    static thread_local std::vector<BaseScalar> unordered;
+    unordered.resize(nnz);
+    model->SparseHessian(ArrayView<const BaseScalar>(input, n),
+                         ArrayView<const BaseScalar>(weights, output_dim()),
+                         ArrayView<BaseScalar>(unordered.data(), nnz), &rows,
+                         &cols);
+    for (std::size_t k = 0; k < nnz; ++k) {
+      values[k] = unordered[hessian_permutation_[k]];
+    }
+  }
+
+  // evaluates the sparse Hessian on a batch of samples in parallel and hands
+  // the values of each sample to `store(sample_index, values)`
+  template <typename Store>
+  void eval_sparse_hessian_(int num_samples,
+                            BatchView<const BaseScalar> local_inputs,
+                            BatchView<const BaseScalar> weights,
+                            BatchView<const BaseScalar> global_input,
+                            const Store &store) const {
+    const int nnz = hessian_sparsity().nnz();
+    for_each_cpu_sample_(
+        num_samples, local_inputs, global_input,
+        [&](GenericModel *model, int i, const BaseScalar *input) {
+          static thread_local std::vector<BaseScalar> values;
+          values.resize(nnz);
+          sparse_hessian_(model, input, weights[i], values.data());
+          store(i, values.data());
+        });
+  }
+
+  // calls `fun(model, i, input)` for each sample on the thread pool, where
+  // `input` points to the full input vector (global input followed by the
+  // local input) of sample `i`
+  template <typename Fun>
+  void for_each_cpu_sample_(int num_samples,
+                            BatchView<const BaseScalar> local_inputs,
+                            BatchView<const BaseScalar> global_input,
+                            const Fun &fun) const {
+    const int gd = global_input_dim();
+    thread_pool()->parallel_for(
+        num_samples, batch_chunk_size, [&](int begin, int end) {
+          auto model = get_cpu_model();
+          std::vector<BaseScalar> input(gd > 0 ? input_dim() : 0);
+          for (int i = begin; i < end; ++i) {
+            const BaseScalar *x = local_inputs[i];
+            if (gd > 0) {
+              assemble_input_(local_inputs[i], global_input[i], input.data(),
+                              i > begin ? global_input[i - 1] : nullptr);
+              x = input.data();
+            }
+            fun(model, i, x);
+          }
+        });
+  }
+
+  // Jacobian-vector product via the generated first-order forward functions
+  void forward_one_(GenericModel *model, const BaseScalar *input,
+                    const BaseScalar *tangent, BaseScalar *output) const {
+    using CppAD::cg::ArrayView;
+    const std::size_t n = input_dim();
+    const std::size_t m = output_dim();
+    // Taylor coefficients of order zero and one are interleaved
+    static thread_local std::vector<BaseScalar> tx, ty;
+    tx.resize(2 * n);
+    ty.resize(2 * m);
+    for (std::size_t j = 0; j < n; ++j) {
+      tx[2 * j] = input[j];
+      tx[2 * j + 1] = tangent[j];
+    }
+    model->ForwardOne(ArrayView<const BaseScalar>(tx.data(), tx.size()),
+                      ArrayView<BaseScalar>(ty.data(), ty.size()));
+    for (std::size_t i = 0; i < m; ++i) {
+      output[i] = ty[2 * i + 1];
+    }
+  }
+
+  // vector-Jacobian product via the generated first-order reverse functions
+  void reverse_one_(GenericModel *model, const BaseScalar *input,
+                    const BaseScalar *cotangent, BaseScalar *output) const {
+    using CppAD::cg::ArrayView;
+    const std::size_t n = input_dim();
+    const std::size_t m = output_dim();
+    // the zero-order outputs are not used by the generated functions
+    static thread_local std::vector<BaseScalar> ty;
+    ty.assign(m, BaseScalar(0));
+    model->ReverseOne(ArrayView<const BaseScalar>(input, n),
+                      ArrayView<const BaseScalar>(ty.data(), m),
+                      ArrayView<BaseScalar>(output, n),
+                      ArrayView<const BaseScalar>(cotangent, m));
+  }
+
+  // loads the Hessian sparsity pattern of the library and converts it to CSR
+  void load_hessian_sparsity_(GenericModel *model) const {
+    hessian_sparsity_ = SparsityPattern();
+    hessian_permutation_.clear();
+    if (!model->isSparseHessianAvailable()) {
+      return;
+    }
+    std::vector<std::size_t> rows, cols;
+    model->HessianSparsity(rows, cols);
+    std::vector<int> order(rows.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return rows[a] != rows[b] ? rows[a] < rows[b] : cols[a] < cols[b];
+    });
+    const int n = static_cast<int>(model->Domain());
+    hessian_sparsity_.num_rows = n;
+    hessian_sparsity_.num_cols = n;
+    hessian_sparsity_.row_offsets.assign(n + 1, 0);
+    for (int k : order) {
+      hessian_sparsity_.col_indices.push_back(static_cast<int>(cols[k]));
+      ++hessian_sparsity_.row_offsets[rows[k] + 1];
+    }
+    for (int i = 0; i < n; ++i) {
+      hessian_sparsity_.row_offsets[i + 1] += hessian_sparsity_.row_offsets[i];
+    }
+    if (!std::is_sorted(order.begin(), order.end())) {
+      hessian_permutation_ = order;
+    }
+  }
+
+  const CpuBatchFunction<BaseScalar> &get_sparse_jacobian_function_() const {
+    if (target_ != TARGET_CPU) {
+      throw std::runtime_error(
+          "Sparse Jacobians are only supported by the CPU target.");
+    }
+    assert(!library_name_.empty());
+    load_cpu_library_if_needed_();
+    if (!cpu_sparse_jacobian_batch_.is_available()) {
+      throw std::runtime_error(
+          "The sparse Jacobian is not available in the library of \"" + name_ +
+          "\". Set generate_sparse_jacobian before compiling the function.");
+    }
+    if (cpu_sparse_jacobian_batch_.global_input_dim() != global_input_dim_) {
+      throw std::runtime_error(
+          "The sparse Jacobian of \"" + name_ + "\" has been compiled for " +
+          std::to_string(cpu_sparse_jacobian_batch_.global_input_dim()) +
+          " global inputs, but " + std::to_string(global_input_dim_) +
+          " are expected.");
+    }
+    return cpu_sparse_jacobian_batch_;
+  }
+
+  const CpuSimdFunction<BaseScalar> &get_cpu_simd_function_(
+      const CpuSimdFunction<BaseScalar> &fun) const {
+    assert(!library_name_.empty());
+    get_cpu_model();
+    if (!fun.is_available()) {
+      throw std::runtime_error(
+          "SIMD functions are not available in the library of \"" + name_ +
+          "\". Set simd_width > 0 before compiling the function.");
+    }
+    if (fun.global_input_dim() != global_input_dim_) {
+      throw std::runtime_error(
+          "SIMD functions of \"" + name_ + "\" have been compiled for " +
+          std::to_string(fun.global_input_dim()) + " global inputs, but " +
+          std::to_string(global_input_dim_) + " are expected.");
+    }
+    return fun;
+  }
+
+  void run_cpu_simd_(const CpuSimdFunction<BaseScalar> &fun, int num_blocks,
+                     const BaseScalar *local_inputs, BaseScalar *outputs,
+                     const BaseScalar *global_input) const {
+    const std::ptrdiff_t in_block = fun.local_input_dim() * fun.simd_width();
+    const std::ptrdiff_t out_block = fun.output_dim() * fun.simd_width();
+    // the chunk size refers to samples, not blocks
+    const int chunk_size = batch_chunk_size > 0
+                               ? soa_num_blocks(batch_chunk_size,
+                                                fun.simd_width())
+                               : 0;
+    thread_pool()->parallel_for(
+        num_blocks, chunk_size, [&](int begin, int end) {
+          fun(end - begin, local_inputs + begin * in_block,
+              outputs + begin * out_block, global_input);
+        });
+  }
+
+  void parallel_for_blocks_(int n,
+                            const std::function<void(int)> &fun) override {
+    thread_pool()->parallel_for(n, 1, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        fun(i);
+      }
+    });
+  }
+
+  inline void load_cpu_library_if_needed_() const {
+    if (!cpu_library_loaded_.load(std::memory_order_acquire)) {
+      load_cpu_library_();
+    }
+  }
+
+  // batch function `fun` of `batch` if it has been compiled for the current
+  // input split, which may have changed since the library was loaded (e.g. by
+  // a batch evaluation with another global input), otherwise nullptr
+  inline CpuBatchFunctionPtrT<BaseScalar> single_sample_fun_(
+      const CpuBatchFunction<BaseScalar> &batch,
+      CpuBatchFunctionPtrT<BaseScalar> fun) const {
+    return batch.global_input_dim() == global_input_dim_ ? fun : nullptr;
+  }
+
+  // evaluates a batch function on a single sample whose input starts with the
+  // global input
+  inline void call_single_(CpuBatchFunctionPtrT<BaseScalar> fun,
+                           const BaseScalar *input, BaseScalar *output) const {
+    fun(1, output, 0, input + global_input_dim_, 0, input, 0);
+  }
+
+  void load_cpu_library_() const {
+    std::lock_guard<std::mutex> lock(cpu_library_loading_mutex_);
+    if (cpu_library_loaded_.load()) {
+      return;
+    }
+    if (jit_library_) {
+      cpu_library_ = jit_library_;
+    } else {
+      cpu_library_ =
+          std::make_shared<DynamicLib>(library_name_ + library_ext_);
+      std::cout << "Successfully loaded CPU library "
+                << library_name_ + library_ext_ << std::endl;
+    }
+    std::set<std::string> model_names = cpu_library_->getModelNames();
+    for (auto &name : model_names) {
+      std::cout << "  Found model " << name << std::endl;
+    }
+
+    cpu_instances_pool_ = thread_pool();
+    cpu_worker_instances_.clear();
+    cpu_thread_instances_.clear();
+    for (int i = 0; i < cpu_instances_pool_->num_workers(); ++i) {
+      cpu_worker_instances_.push_back(create_cpu_instance_(i == 0));
+    }
+
+    cpu_forward_zero_batch_ = CpuBatchFunction<BaseScalar>(
+        name_ + "_forward_zero_batch", *cpu_library_);
+    cpu_jacobian_batch_ = CpuBatchFunction<BaseScalar>(
+        name_ + "_jacobian_batch", *cpu_library_);
+    cpu_value_and_jacobian_batch_ = CpuBatchFunction<BaseScalar>(
+        name_ + "_value_and_jacobian_batch", *cpu_library_);
+    cpu_sparse_jacobian_batch_ = CpuBatchFunction<BaseScalar>(
+        name_ + "_sparse_jacobian_batch", *cpu_library_);
+    load_hessian_sparsity_(cpu_worker_instances_.front()->model);
+    jacobian_sparsity_ = SparsityPattern();
+    if (cpu_sparse_jacobian_batch_.is_available()) {
+      auto pattern_fun = (CpuSparsityFunctionPtrT)cpu_library_->loadFunction(
+          name_ + "_sparse_jacobian_pattern", true);
+      int nnz;
+      const int *row_offsets, *col_indices;
+      pattern_fun(&jacobian_sparsity_.num_rows, &jacobian_sparsity_.num_cols,
+                  &nnz, &row_offsets, &col_indices);
+      jacobian_sparsity_.row_offsets.assign(
+          row_offsets, row_offsets + jacobian_sparsity_.num_rows + 1);
+      jacobian_sparsity_.col_indices.assign(col_indices, col_indices + nnz);
+    }
+    cpu_forward_zero_simd_ = CpuSimdFunction<BaseScalar>(
+        name_ + "_forward_zero_simd", *cpu_library_);
+    cpu_jacobian_simd_ = CpuSimdFunction<BaseScalar>(
+        name_ + "_jacobian_simd", *cpu_library_);
+    // the batch functions call their atomic functions directly, so they can
+    // serve as the fast path for single samples (see `single_sample_fun_()`)
+    cpu_forward_zero_ptr_ = cpu_forward_zero_batch_.function_ptr();
+    cpu_jacobian_ptr_ = cpu_jacobian_batch_.function_ptr();
+    cpu_value_and_jacobian_ptr_ = cpu_value_and_jacobian_batch_.function_ptr();
+
+    cpu_library_id_ = next_cpu_library_id_++;
+    std::cout << "Loaded compiled model \"" << name_ << "\" from \""
+              << library_name_ << "\" with "
+              << cpu_worker_instances_.size() << " instance(s).\n";
+    cpu_library_loaded_.store(true, std::memory_order_release);
+  }
+
+  void unload_cpu_library_() {
+    std::lock_guard<std::mutex> lock(cpu_library_loading_mutex_);
+    cpu_library_loaded_ = false;
+    // the models have to be destroyed before the library is closed
+    cpu_worker_instances_.clear();
+    cpu_thread_instances_.clear();
+    cpu_forward_zero_batch_ = CpuBatchFunction<BaseScalar>();
+    cpu_jacobian_batch_ = CpuBatchFunction<BaseScalar>();
+    cpu_value_and_jacobian_batch_ = CpuBatchFunction<BaseScalar>();
+    cpu_sparse_jacobian_batch_ = CpuBatchFunction<BaseScalar>();
+    jacobian_sparsity_ = SparsityPattern();
+    hessian_sparsity_ = SparsityPattern();
+    hessian_permutation_.clear();
+    cpu_forward_zero_simd_ = CpuSimdFunction<BaseScalar>();
+    cpu_jacobian_simd_ = CpuSimdFunction<BaseScalar>();
+    cpu_forward_zero_ptr_ = nullptr;
+    cpu_jacobian_ptr_ = nullptr;
+    cpu_value_and_jacobian_ptr_ = nullptr;
+    cpu_library_ = nullptr;
+  }
+
+  GenericModel *get_thread_instance_() const {
+    std::lock_guard<std::mutex> lock(cpu_library_loading_mutex_);
+    auto &instance = cpu_thread_instances_[std::this_thread::get_id()];
+    if (!instance) {
+      instance = create_cpu_instance_(false);
+    }
+    return instance->model;
+  }
+
+  /**
+   * Loads the main model from the CPU library and wires it up with newly
+   * loaded models of the atomic functions it calls.
+   */
+  std::unique_ptr<CpuModelInstance> create_cpu_instance_(bool verbose) const {
+    auto instance = std::make_unique<CpuModelInstance>();
+    auto &models = instance->models;
+    models[name_] = GenericModelPtr(cpu_library_->model(name_).release());
+    if (!models[name_]) {
+      throw std::runtime_error("Failed to load model from library " +
+                               library_name_ + library_ext_);
+    }
+    // atomic functions to be added
+    typedef std::pair<std::string, std::string> ParentChild;
+    std::set<ParentChild> remaining_atomics;
+    for (const std::string &s : models[name_]->getAtomicFunctionNames()) {
+      remaining_atomics.insert(std::make_pair(name_, s));
+    }
+    while (!remaining_atomics.empty()) {
+      ParentChild member = *(remaining_atomics.begin());
+      const std::string &parent = member.first;
+      const std::string &atomic_name = member.second;
+      remaining_atomics.erase(remaining_atomics.begin());
+      if (models.find(atomic_name) == models.end()) {
+        if (verbose) {
+          std::cout << "  Adding atomic function " << atomic_name << std::endl;
+        }
+        models[atomic_name] =
+            GenericModelPtr(cpu_library_->model(atomic_name).release());
+        for (const std::string &s :
+             models[atomic_name]->getAtomicFunctionNames()) {
+          remaining_atomics.insert(std::make_pair(atomic_name, s));
+        }
+      }
+      auto &atomic_model = models[atomic_name];
+      models[parent]->addAtomicFunction(atomic_model->asAtomic());
+    }
+    instance->model = models[name_].get();
+    return instance;
+  }
+
+  static void from_nested_(const std::vector<std::vector<BaseScalar>> &rows,
+                           BatchView<BaseScalar> outputs) {
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+      std::copy(rows[i].begin(), rows[i].end(),
+                outputs[static_cast<int>(i)]);
+    }
+  }
+
  private:
 #if AUTOGEN_SYSTEM_WIN
   static const inline std::string library_ext_ = ".dll";
@@ -459,4 +2495,6 @@ class GeneratedCodeGen : public GeneratedBase {
   static const inline std::string library_ext_ = ".so";
 #endif
 };
+
+using GeneratedCodeGen = GeneratedCodeGenT<BaseScalar>;
 }  // namespace autogen
\ No newline at end of file
@@ -14,7 +14,9 @@
 // clang-format on
 
 namespace autogen {
-class GeneratedCppAD : public GeneratedBase {
+template <typename BaseScalar = double>
+class GeneratedCppADT : public GeneratedBaseT<BaseScalar> {
+  using GeneratedBase = GeneratedBaseT<BaseScalar>;
   using ADScalar = typename CppAD::AD<BaseScalar>;
   using Functor = typename std::function<void(const std::vector<ADScalar>&,
                                               std::vector<ADScalar>&)>;
@@ -32,17 +34,29 @@ class GeneratedCppAD : public GeneratedBase {
   using GeneratedBase::local_input_dim_;
   using GeneratedBase::output_dim_;
 
+  using GeneratedBase::assemble_input_;
+
  public:
-  GeneratedCppAD(const std::vector<ADScalar>& ax,
-                 const std::vector<ADScalar>& ay) {
+  using GeneratedBase::hessian;
+  using GeneratedBase::input_dim;
+  using GeneratedBase::jacobian;
+  using GeneratedBase::jvp;
+  using GeneratedBase::vjp;
+  using GeneratedBase::operator();
+
+  GeneratedCppADT(const std::vector<ADScalar>& ax,
+                  const std::vector<ADScalar>& ay) {
     tape_ = std::make_shared<CppAD::ADFun<BaseScalar>>();
     tape_->Dependent(ax, ay);
+    update_dims_();
   }
 
-  GeneratedCppAD(std::shared_ptr<CppAD::ADFun<BaseScalar>> tape)
-      : tape_(tape) {}
+  GeneratedCppADT(std::shared_ptr<CppAD::ADFun<BaseScalar>> tape)
+      : tape_(tape) {
+    update_dims_();
+  }
 
-  GeneratedCppAD(Functor functor, const std::vector<BaseScalar>& input)
+  GeneratedCppADT(Functor functor, const std::vector<BaseScalar>& input)
       : functor_(functor) {
     conditionally_trace_(input);
   }
@@ -54,28 +68,26 @@ class GeneratedCppAD : public GeneratedBase {
     ADScalar::abort_recording();
   }
 
+  void set_global_input_dim(int dim) override {
+    global_input_dim_ = dim;
+    update_dims_();
+  }
+
   void operator()(const std::vector<BaseScalar>& input,
                   std::vector<BaseScalar>& output) override {
     conditionally_trace_(input);
     output = tape_->Forward(0, input);
   }
 
-  void operator()(const std::vector<std::vector<BaseScalar>>& local_inputs,
-                  std::vector<std::vector<BaseScalar>>& outputs,
-                  const std::vector<BaseScalar>& global_input) override {
-    if (global_input.empty()) {
-      for (size_t i = 0; i < local_inputs.size(); ++i) {
-        outputs[i] = tape_->Forward(0, local_inputs[i]);
-      }
-    } else {
-      std::vector<BaseScalar> input(global_input);
-      input.resize(global_input.size() + local_inputs[0].size());
-      for (size_t i = 0; i < local_inputs.size(); ++i) {
-        for (size_t j = 0; j < local_inputs[i].size(); ++j) {
-          input[j + global_input.size()] = local_inputs[i][j];
-        }
-        outputs[i] = tape_->Forward(0, input);
-      }
+  void operator()(int num_samples, BatchView<const BaseScalar> local_inputs,
+                  BatchView<BaseScalar> outputs,
+                  BatchView<const BaseScalar> global_input = {}) override {
+    std::vector<BaseScalar> input(input_dim()), output;
+    for (int i = 0; i < num_samples; ++i) {
+      assemble_input_(local_inputs[i], global_input[i], input.data(),
+                      i > 0 ? global_input[i - 1] : nullptr);
+      output = tape_->Forward(0, input);
+      std::copy(output.begin(), output.end(), outputs[i]);
     }
   }
 
@@ -85,27 +97,93 @@ class GeneratedCppAD : public GeneratedBase {
     output = tape_->Jacobian(input);
   }
 
-  void jacobian(const std::vector<std::vector<BaseScalar>>& local_inputs,
-                std::vector<std::vector<BaseScalar>>& outputs,
-                const std::vector<BaseScalar>& global_input) override {
-    outputs.resize(local_inputs.size());
-    if (global_input.empty()) {
-      for (size_t i = 0; i < local_inputs.size(); ++i) {
-        jacobian(local_inputs[i], outputs[i]);
+  void jacobian(int num_samples, BatchView<const BaseScalar> local_inputs,
+                BatchView<BaseScalar> outputs,
+                BatchView<const BaseScalar> global_input = {}) override {
+    std::vector<BaseScalar> input(input_dim()), output;
+    for (int i = 0; i < num_samples; ++i) {
+      assemble_input_(local_inputs[i], global_input[i], input.data(),
+                      i > 0 ? global_input[i - 1] : nullptr);
+      output = tape_->Jacobian(input);
+      std::copy(output.begin(), output.end(), outputs[i]);
+    }
+  }
+
+  void value_and_jacobian(const std::vector<BaseScalar>& input,
+                          std::vector<BaseScalar>& output,
+                          std::vector<BaseScalar>& jac) override {
+    conditionally_trace_(input);
+    output = tape_->Forward(0, input);
+    jac.resize(output.size() * input.size());
+    jacobian_from_forward_(jac.data());
+  }
+
+  void value_and_jacobian(
+      int num_samples, BatchView<const BaseScalar> local_inputs,
+      BatchView<BaseScalar> outputs, BatchView<BaseScalar> jacobians,
+      BatchView<const BaseScalar> global_input = {}) override {
+    std::vector<BaseScalar> input(input_dim()), output;
+    for (int i = 0; i < num_samples; ++i) {
+      assemble_input_(local_inputs[i], global_input[i], input.data(),
+                      i > 0 ? global_input[i - 1] : nullptr);
+      output = tape_->Forward(0, input);
+      std::copy(output.begin(), output.end(), outputs[i]);
+      jacobian_from_forward_(jacobians[i]);
+    }
+  }
+
+  void hessian(const std::vector<BaseScalar>& input,
+               const std::vector<BaseScalar>& weights,
+               std::vector<BaseScalar>& output) override {
+    conditionally_trace_(input);
+    output = tape_->Hessian(input, weights);
+  }
+
+  void jvp(const std::vector<BaseScalar>& input,
+           const std::vector<BaseScalar>& tangent,
+           std::vector<BaseScalar>& output) override {
+    conditionally_trace_(input);
+    tape_->Forward(0, input);
+    output = tape_->Forward(1, tangent);
+  }
+
+  void vjp(const std::vector<BaseScalar>& input,
+           const std::vector<BaseScalar>& cotangent,
+           std::vector<BaseScalar>& output) override {
+    conditionally_trace_(input);
+    tape_->Forward(0, input);
+    output = tape_->Reverse(1, cotangent);
+  }
+
+ protected:
+  /**
+   * Computes the row-major Jacobian via first-order sweeps that reuse the
+   * zero-order forward pass which has just been evaluated on the tape.
+   */
+  void jacobian_from_forward_(BaseScalar* jac) {
+    const std::size_t n = tape_->Domain();
+    const std::size_t m = tape_->Range();
+    if (n <= m) {
+      std::vector<BaseScalar> dx(n, 0.0), dy;
+      for (std::size_t j = 0; j < n; ++j) {
+        dx[j] = 1.0;
+        dy = tape_->Forward(1, dx);
+        dx[j] = 0.0;
+        for (std::size_t i = 0; i < m; ++i) {
+          jac[i * n + j] = dy[i];
+        }
       }
     } else {
-      std::vector<BaseScalar> input(global_input.size());
-      input.insert(input.begin(), global_input.begin(), global_input.end());
-      for (size_t i = 0; i < local_inputs.size(); ++i) {
-        for (size_t j = 0; j < local_inputs[i].size(); ++i) {
-          input[j + global_input.size()] = local_inputs[i][j];
-        }
-        jacobian(input, outputs[i]);
+      std::vector<BaseScalar> w(m, 0.0), dw;
+      for (std::size_t i = 0; i < m; ++i) {
+        w[i] = 1.0;
+        dw = tape_->Reverse(1, w);
+        w[i] = 0.0;
+        std::copy(dw.begin(), dw.end(), jac + i * n);
       }
     }
   }
 
- protected:
   void conditionally_trace_(const std::vector<BaseScalar>& input) {
     if (tape_) {
       return;
@@ -124,6 +202,17 @@ class GeneratedCppAD : public GeneratedBase {
     functor_(ax_, ay_);
     tape_ = std::make_shared<CppAD::ADFun<BaseScalar>>();
     tape_->Dependent(ax_, ay_);
+    update_dims_();
+  }
+
+  void update_dims_() {
+    if (!tape_) {
+      return;
+    }
+    local_input_dim_ = static_cast<int>(tape_->Domain()) - global_input_dim_;
+    output_dim_ = static_cast<int>(tape_->Range());
   }
 };
+
+using GeneratedCppAD = GeneratedCppADT<BaseScalar>;
 }  // namespace autogen
\ No newline at end of file
@@ -0,0 +1,207 @@
+#pragma once
+
+// clang-format off
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../cpu/cpu_function.hpp"
+#include "../utils/shared_library.hpp"
+#include "../utils/thread_pool.hpp"
+#include "base.hpp"
+// clang-format on
+
+namespace autogen {
+/**
+ * Runtime-only evaluator of a function whose CPU library has been compiled
+ * beforehand (e.g. via `GeneratedCodeGen::compile_cpu()` with
+ * `generate_batch` enabled). The function is evaluated through the batched
+ * entry points of the library, whose per-sample code contains the atomic
+ * functions inline, so that neither CppAD nor CppADCodeGen are needed to load
+ * and call it.
+ */
+template <typename BaseScalar = double>
+class GeneratedLightWeight : public GeneratedBaseT<BaseScalar> {
+  using GeneratedBase = GeneratedBaseT<BaseScalar>;
+
+ protected:
+  using GeneratedBase::global_input_dim_;
+  using GeneratedBase::local_input_dim_;
+  using GeneratedBase::output_dim_;
+
+  std::string name_;
+  std::shared_ptr<SharedLibrary> library_;
+
+  CpuBatchFunction<BaseScalar> forward_zero_;
+  CpuBatchFunction<BaseScalar> jacobian_;
+  CpuBatchFunction<BaseScalar> value_and_jacobian_;
+
+  mutable std::shared_ptr<ThreadPool> thread_pool_{nullptr};
+
+ public:
+  using GeneratedBase::input_dim;
+  using GeneratedBase::jacobian;
+  using GeneratedBase::output_dim;
+  using GeneratedBase::operator();
+
+  /**
+   * Number of samples per task of the thread pool in vectorized evaluations.
+   * If zero, the batch is split into a few chunks per worker.
+   */
+  int batch_chunk_size{0};
+
+  /**
+   * Loads the CPU library of the function `name` from
+   * `<library_basename>.so` (`.dll` on Windows), where the basename defaults
+   * to `./<name>_cpu` which is the library written by `compile_cpu()`. The
+   * input and output dimensions are read from the library.
+   */
+  explicit GeneratedLightWeight(const std::string &name,
+                                const std::string &library_basename = "")
+      : name_(name) {
+    const std::string basename =
+        library_basename.empty() ? "./" + name + "_cpu" : library_basename;
+    library_ = std::make_shared<SharedLibrary>(basename +
+                                               SharedLibrary::extension);
+    forward_zero_ = CpuBatchFunction<BaseScalar>(
+        name + "_forward_zero_batch", *library_);
+    jacobian_ =
+        CpuBatchFunction<BaseScalar>(name + "_jacobian_batch", *library_);
+    value_and_jacobian_ = CpuBatchFunction<BaseScalar>(
+        name + "_value_and_jacobian_batch", *library_);
+    const CpuBatchFunction<BaseScalar> &any =
+        forward_zero_.is_available() ? forward_zero_ : jacobian_;
+    if (!any.is_available()) {
+      throw std::runtime_error(
+          "The library \"" + library_->filename() +
+          "\" does not contain the batch functions of \"" + name +
+          "\". It has to be compiled with `generate_batch` enabled.");
+    }
+    local_input_dim_ = any.local_input_dim();
+    global_input_dim_ = any.global_input_dim();
+    output_dim_ = forward_zero_.is_available()
+                      ? forward_zero_.output_dim()
+                      : jacobian_.output_dim() / input_dim();
+  }
+
+  const std::string &name() const { return name_; }
+
+  // the input split has been fixed when the library was compiled
+  void set_global_input_dim(int dim) override {
+    if (dim != global_input_dim_) {
+      throw std::runtime_error(
+          "The global input dimension of \"" + name_ + "\" is " +
+          std::to_string(global_input_dim_) +
+          " as it has been compiled, it cannot be changed to " +
+          std::to_string(dim) + ".");
+    }
+  }
+
+  /**
+   * Thread pool that runs the vectorized evaluations. Unless set explicitly,
+   * the pool returned by `ThreadPool::global()` is used.
+   */
+  const std::shared_ptr<ThreadPool> &thread_pool() const {
+    if (!thread_pool_) {
+      thread_pool_ = ThreadPool::global();
+    }
+    return thread_pool_;
+  }
+  void set_thread_pool(std::shared_ptr<ThreadPool> thread_pool) {
+    thread_pool_ = std::move(thread_pool);
+  }
+
+  void operator()(const std::vector<BaseScalar> &input,
+                  std::vector<BaseScalar> &output) override {
+    check_input_(input.size());
+    output.resize(output_dim());
+    (*this)(input.data(), output.data());
+  }
+
+  void operator()(const BaseScalar *input, BaseScalar *output) override {
+    call_single_(forward_zero_, input, output);
+  }
+
+  void operator()(int num_samples, BatchView<const BaseScalar> local_inputs,
+                  BatchView<BaseScalar> outputs,
+                  BatchView<const BaseScalar> global_input = {}) override {
+    run_batch_(forward_zero_, num_samples, local_inputs, outputs,
+               global_input);
+  }
+
+  void jacobian(const std::vector<BaseScalar> &input,
+                std::vector<BaseScalar> &output) override {
+    check_input_(input.size());
+    output.resize(output_dim() * input_dim());
+    jacobian(input.data(), output.data());
+  }
+
+  void jacobian(const BaseScalar *input, BaseScalar *output) override {
+    call_single_(jacobian_, input, output);
+  }
+
+  void jacobian(int num_samples, BatchView<const BaseScalar> local_inputs,
+                BatchView<BaseScalar> outputs,
+                BatchView<const BaseScalar> global_input = {}) override {
+    run_batch_(jacobian_, num_samples, local_inputs, outputs, global_input);
+  }
+
+  /**
+   * Uses the fused function of the library if it has been compiled with
+   * `generate_value_and_jacobian`.
+   */
+  void value_and_jacobian(const std::vector<BaseScalar> &input,
+                          std::vector<BaseScalar> &output,
+                          std::vector<BaseScalar> &jac) override {
+    if (!value_and_jacobian_.is_available()) {
+      GeneratedBase::value_and_jacobian(input, output, jac);
+      return;
+    }
+    check_input_(input.size());
+    const int od = output_dim();
+    // the fused function writes outputs and Jacobian contiguously
+    std::vector<BaseScalar> result(od * (1 + input_dim()));
+    call_single_(value_and_jacobian_, input.data(), result.data());
+    output.assign(result.begin(), result.begin() + od);
+    jac.assign(result.begin() + od, result.end());
+  }
+
+ protected:
+  void check_input_(std::size_t size) const {
+    if (static_cast<int>(size) != input_dim()) {
+      throw std::runtime_error("Function \"" + name_ + "\" expects " +
+                               std::to_string(input_dim()) +
+                               " inputs, but " + std::to_string(size) +
+                               " were given.");
+    }
+  }
+
+  // the input holds the global input followed by the local input
+  void call_single_(const CpuBatchFunction<BaseScalar> &fun,
+                    const BaseScalar *input, BaseScalar *output) const {
+    fun(1, {input + global_input_dim_, 0}, {output, 0}, {input, 0});
+  }
+
+  void run_batch_(const CpuBatchFunction<BaseScalar> &fun, int num_samples,
+                  BatchView<const BaseScalar> local_inputs,
+                  BatchView<BaseScalar> outputs,
+                  BatchView<const BaseScalar> global_input) const {
+    thread_pool()->parallel_for(
+        num_samples, batch_chunk_size, [&](int begin, int end) {
+          fun(end - begin, {local_inputs[begin], local_inputs.stride},
+              {outputs[begin], outputs.stride},
+              {global_input[begin], global_input.stride});
+        });
+  }
+
+  void parallel_for_blocks_(int n,
+                            const std::function<void(int)> &fun) override {
+    thread_pool()->parallel_for(n, 1, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        fun(i);
+      }
+    });
+  }
+};
+}  // namespace autogen
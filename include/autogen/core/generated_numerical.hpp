@@ -7,11 +7,14 @@
 // clang-format on
 
 namespace autogen {
-class GeneratedNumerical : public GeneratedBase {
+template <typename BaseScalar = double>
+class GeneratedNumericalT : public GeneratedBaseT<BaseScalar> {
+  using GeneratedBase = GeneratedBaseT<BaseScalar>;
+
  public:
   using Functor = typename std::function<void(const std::vector<BaseScalar> &,
                                               std::vector<BaseScalar> &)>;
-  using ADScalar = double;
+  using ADScalar = BaseScalar;
 
  private:
   Functor functor_;
@@ -21,18 +24,26 @@ class GeneratedNumerical : public GeneratedBase {
   using GeneratedBase::local_input_dim_;
   using GeneratedBase::output_dim_;
 
+  using GeneratedBase::assemble_input_;
+
  public:
+  using GeneratedBase::input_dim;
+  using GeneratedBase::jacobian;
+  using GeneratedBase::output_dim;
+  using GeneratedBase::operator();
+
   /**
-   * Step size to use for finite differencing.
+   * Step size to use for finite differencing, which is larger in single
+   * precision to limit the cancellation error.
    */
-  double finite_diff_eps{1e-6};
+  double finite_diff_eps{sizeof(BaseScalar) < sizeof(double) ? 1e-3 : 1e-6};
 
-  GeneratedNumerical(Functor functor) : functor_(functor) {}
+  GeneratedNumericalT(Functor functor) : functor_(functor) {}
 
   void operator()(const std::vector<BaseScalar> &input,
                   std::vector<BaseScalar> &output) override {
     if (local_input_dim_ < 0) {
-      local_input_dim_ = static_cast<int>(input.size());
+      local_input_dim_ = static_cast<int>(input.size()) - global_input_dim_;
     }
     functor_(input, output);
     if (output_dim_ < 0) {
@@ -40,34 +51,54 @@ class GeneratedNumerical : public GeneratedBase {
     }
   }
 
-  void operator()(const std::vector<std::vector<BaseScalar>> &local_inputs,
-                  std::vector<std::vector<BaseScalar>> &outputs,
-                  const std::vector<BaseScalar> &global_input = {}) override {
-    if (local_inputs.empty()) {
+  void operator()(int num_samples, BatchView<const BaseScalar> local_inputs,
+                  BatchView<BaseScalar> outputs,
+                  BatchView<const BaseScalar> global_input = {}) override {
+    if (num_samples <= 0) {
       return;
     }
-
-    if (global_input.empty()) {
-      for (size_t i = 0; i < local_inputs.size(); ++i) {
-        functor_(local_inputs[i], outputs[i]);
-      }
-    } else {
-      std::vector<BaseScalar> input(global_input);
-      input.resize(global_input.size() + local_inputs[0].size());
-      for (size_t i = 0; i < local_inputs.size(); ++i) {
-        for (size_t j = 0; j < local_inputs[i].size(); ++j) {
-          input[j + global_input.size()] = local_inputs[i][j];
-        }
-        functor_(input, outputs[i]);
-      }
+    std::vector<BaseScalar> input(input_dim()), output(output_dim());
+    for (int i = 0; i < num_samples; ++i) {
+      assemble_input_(local_inputs[i], global_input[i], input.data(),
+                      i > 0 ? global_input[i - 1] : nullptr);
+      functor_(input, output);
+      std::copy(output.begin(), output.end(), outputs[i]);
     }
   }
 
   void jacobian(const std::vector<BaseScalar> &input,
                 std::vector<BaseScalar> &output) override {
+    if (local_input_dim_ < 0 || output_dim_ < 0) {
+      // discover the dimensions by evaluating the function once
+      (*this)(input, output);
+    }
     // central difference
     assert(output_dim() > 0);
     output.resize(input_dim() * output_dim());
+    jacobian_(input, output.data());
+  }
+
+  void jacobian(int num_samples, BatchView<const BaseScalar> local_inputs,
+                BatchView<BaseScalar> outputs,
+                BatchView<const BaseScalar> global_input = {}) override {
+    std::vector<BaseScalar> input(input_dim());
+    for (int i = 0; i < num_samples; ++i) {
+      assemble_input_(local_inputs[i], global_input[i], input.data(),
+                      i > 0 ? global_input[i - 1] : nullptr);
+      jacobian_(input, outputs[i]);
+    }
+  }
+
+  void set_global_input_dim(int dim) override {
+    if (local_input_dim_ >= 0) {
+      // keep the total input dimension
+      local_input_dim_ += global_input_dim_ - dim;
+    }
+    global_input_dim_ = dim;
+  }
+
+ protected:
+  void jacobian_(const std::vector<BaseScalar> &input, BaseScalar *output) {
     std::vector<BaseScalar> left_x = input, right_x = input;
     std::vector<BaseScalar> left_y(output_dim()), right_y(output_dim());
     for (size_t i = 0; i < input.size(); ++i) {
@@ -76,33 +107,13 @@ class GeneratedNumerical : public GeneratedBase {
       BaseScalar dx = right_x[i] - left_x[i];
       functor_(left_x, left_y);
       functor_(right_x, right_y);
-      for (size_t j = 0; j < output_dim(); ++j) {
+      for (int j = 0; j < output_dim(); ++j) {
         output[j * input_dim() + i] = (right_y[j] - left_y[j]) / dx;
       }
       left_x[i] = right_x[i] = input[i];
     }
   }
-
-  void jacobian(const std::vector<std::vector<BaseScalar>> &local_inputs,
-                std::vector<std::vector<BaseScalar>> &outputs,
-                const std::vector<BaseScalar> &global_input = {}) override {
-    outputs.resize(local_inputs.size());
-
-    if (global_input.empty()) {
-      for (size_t i = 0; i < local_inputs.size(); ++i) {
-        jacobian(local_inputs[i], outputs[i]);
-      }
-    } else {
-      std::vector<BaseScalar> input(global_input.size());
-      input.insert(input.begin(), global_input.begin(), global_input.end());
-      for (size_t i = 0; i < local_inputs.size(); ++i) {
-        for (size_t j = 0; j < local_inputs[i].size(); ++i) {
-          input[j + global_input.size()] = local_inputs[i][j];
-        }
-        jacobian(input, outputs[i]);
-      }
-    }
-    return;
-  }
 };
-}  // namespace autogen
\ No newline at end of file
+
+using GeneratedNumerical = GeneratedNumericalT<BaseScalar>;
+}  // namespace autogen
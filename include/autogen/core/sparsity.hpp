@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <set>
+#include <vector>
+
+namespace autogen {
+/**
+ * Sparsity pattern of a matrix in compressed sparse row (CSR) format. The
+ * nonzero entries of row `i` are located in the columns
+ * `col_indices[row_offsets[i]], ..., col_indices[row_offsets[i + 1] - 1]`,
+ * sorted in ascending order.
+ */
+struct SparsityPattern {
+  int num_rows{0};
+  int num_cols{0};
+  std::vector<int> row_offsets;
+  std::vector<int> col_indices;
+
+  int nnz() const { return static_cast<int>(col_indices.size()); }
+  bool empty() const { return row_offsets.empty(); }
+
+  /**
+   * Row index of each nonzero entry (i.e. the rows of the COO format).
+   */
+  std::vector<int> row_indices() const {
+    std::vector<int> rows(col_indices.size());
+    for (int i = 0; i < num_rows; ++i) {
+      for (int k = row_offsets[i]; k < row_offsets[i + 1]; ++k) {
+        rows[k] = i;
+      }
+    }
+    return rows;
+  }
+
+  /**
+   * Scatters the nonzero `values` (in CSR order) into the row-major dense
+   * matrix `dense` of size `num_rows * num_cols`.
+   */
+  template <typename Scalar>
+  void to_dense(const Scalar *values, Scalar *dense) const {
+    std::fill(dense, dense + static_cast<std::size_t>(num_rows) * num_cols,
+              Scalar(0));
+    for (int i = 0; i < num_rows; ++i) {
+      for (int k = row_offsets[i]; k < row_offsets[i + 1]; ++k) {
+        dense[static_cast<std::size_t>(i) * num_cols + col_indices[k]] =
+            values[k];
+      }
+    }
+  }
+};
+
+/**
+ * Computes the sparsity pattern of the Jacobian of the given CppAD function
+ * via forward or reverse Jacobian sparsity sweeps, whichever requires fewer
+ * sweeps.
+ */
+template <class ADFun>
+SparsityPattern jacobian_sparsity(ADFun &fun) {
+  const std::size_t n = fun.Domain();
+  const std::size_t m = fun.Range();
+  // columns of the nonzero entries per row
+  std::vector<std::set<std::size_t>> pattern;
+  if (n <= m) {
+    std::vector<std::set<std::size_t>> identity(n);
+    for (std::size_t j = 0; j < n; ++j) {
+      identity[j].insert(j);
+    }
+    pattern = fun.ForSparseJac(n, identity);
+  } else {
+    std::vector<std::set<std::size_t>> identity(m);
+    for (std::size_t i = 0; i < m; ++i) {
+      identity[i].insert(i);
+    }
+    pattern = fun.RevSparseJac(m, identity);
+  }
+
+  SparsityPattern csr;
+  csr.num_rows = static_cast<int>(m);
+  csr.num_cols = static_cast<int>(n);
+  csr.row_offsets.push_back(0);
+  for (const auto &row : pattern) {
+    for (std::size_t j : row) {
+      csr.col_indices.push_back(static_cast<int>(j));
+    }
+    csr.row_offsets.push_back(static_cast<int>(csr.col_indices.size()));
+  }
+  return csr;
+}
+}  // namespace autogen
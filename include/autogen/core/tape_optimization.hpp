@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "codegen.hpp"
+
+namespace autogen {
+/**
+ * Stages of the tape optimization pipeline that runs before the code of the
+ * traced functions is generated (see `GeneratedCodeGen::optimize_tapes`).
+ */
+struct TapeOptimizationOptions {
+  /**
+   * Replaces the outputs that evaluate to constants in the operation graph
+   * (e.g. via the simplifications of CppADCodeGen) by these constants, so
+   * that the operations they were computed from become dead code.
+   */
+  bool fold_constants{true};
+  /**
+   * Replaces the outputs of atomic functions that none of their callers uses
+   * by zeros, so that the operations they were computed from become dead
+   * code.
+   */
+  bool eliminate_dead_outputs{true};
+  /**
+   * Whether to run `ADFun::optimize()` of CppAD, which removes dead code and
+   * merges common subexpressions, on every tape.
+   */
+  bool cppad_optimize{true};
+  /**
+   * Options passed to `ADFun::optimize()`, see the CppAD documentation. The
+   * generated code never evaluates comparison operators, so they are
+   * dropped by default.
+   */
+  std::string cppad_optimize_options{"no_compare_op"};
+};
+
+/**
+ * Number of operations and variables of a tape after a stage of the
+ * optimization pipeline.
+ */
+struct TapeOperationCount {
+  std::string stage;
+  std::size_t operations{0};
+  std::size_t variables{0};
+};
+
+template <typename BaseScalar>
+TapeOperationCount count_operations(
+    const std::string &stage,
+    const CppAD::ADFun<CppAD::cg::CG<BaseScalar>> &tape) {
+  return {stage, tape.size_op(), tape.size_var()};
+}
+
+/**
+ * Records the tape of `trace` again by calling its functor at the trace
+ * input, where the outputs in `replacements` are set to the given constants.
+ * The tape object is updated in place since the atomic function bridges
+ * refer to it.
+ */
+template <typename BaseScalar>
+void retape(FunctionTrace<BaseScalar> &trace,
+            const std::map<std::size_t, BaseScalar> &replacements) {
+  using ADCGScalar = typename FunctionTrace<BaseScalar>::ADCGScalar;
+  if (!trace.functor) {
+    throw std::runtime_error("The functor of \"" + trace.name +
+                             "\" is required to record its tape again.");
+  }
+  std::vector<ADCGScalar> ax(trace.input_dim), ay(trace.output_dim);
+  for (int i = 0; i < trace.input_dim; ++i) {
+    ax[i] = ADCGScalar(trace.trace_input[i]);
+  }
+  CppAD::Independent(ax);
+  trace.functor(ax, ay);
+  for (const auto &[i, value] : replacements) {
+    ay[i] = ADCGScalar(value);
+  }
+  trace.tape->Dependent(ax, ay);
+  trace.tape->function_name_set(trace.name);
+}
+
+/**
+ * Constant values of the outputs of `tape` that are variables on the tape
+ * but evaluate to constants in the operation graph.
+ */
+template <typename BaseScalar>
+std::map<std::size_t, BaseScalar> constant_outputs(
+    CppAD::ADFun<CppAD::cg::CG<BaseScalar>> &tape) {
+  using CGScalar = typename CppAD::cg::CG<BaseScalar>;
+  CppAD::cg::CodeHandler<BaseScalar> handler;
+  std::vector<CGScalar> x(tape.Domain());
+  handler.makeVariables(x);
+  const std::vector<CGScalar> y = tape.Forward(0, x);
+  std::map<std::size_t, BaseScalar> constants;
+  for (std::size_t i = 0; i < y.size(); ++i) {
+    if (!tape.Parameter(i) && y[i].isParameter()) {
+      constants[i] = y[i].getValue();
+    }
+  }
+  return constants;
+}
+
+/**
+ * Adds the indices of the outputs of the atomic functions that are read in
+ * the operation graph of `tape` to `used`, which maps the names of the atomic
+ * functions to these indices.
+ */
+template <typename BaseScalar>
+void collect_used_atomic_outputs(
+    CppAD::ADFun<CppAD::cg::CG<BaseScalar>> &tape,
+    std::map<std::string, std::set<std::size_t>> &used) {
+  using CGScalar = typename CppAD::cg::CG<BaseScalar>;
+  using Node = typename CppAD::cg::OperationNode<BaseScalar>;
+  using CppAD::cg::CGOpCode;
+
+  CppAD::cg::CodeHandler<BaseScalar> handler;
+  std::vector<CGScalar> x(tape.Domain());
+  handler.makeVariables(x);
+  const std::vector<CGScalar> y = tape.Forward(0, x);
+
+  std::set<const Node *> visited;
+  std::vector<const Node *> stack;
+  for (const CGScalar &dep : y) {
+    if (dep.getOperationNode() != nullptr) {
+      stack.push_back(dep.getOperationNode());
+    }
+  }
+  while (!stack.empty()) {
+    const Node *node = stack.back();
+    stack.pop_back();
+    if (!visited.insert(node).second) {
+      continue;
+    }
+    const auto &args = node->getArguments();
+    // the outputs of an atomic function are read from its result array by
+    // their index
+    if (node->getOperationType() == CGOpCode::ArrayElement &&
+        args.size() > 1 && args[1].getOperation() != nullptr &&
+        args[1].getOperation()->getOperationType() ==
+            CGOpCode::AtomicForward) {
+      const std::string *name = handler.getAtomicFunctionName(
+          args[1].getOperation()->getInfo()[0]);
+      if (name != nullptr) {
+        used[*name].insert(node->getInfo()[0]);
+      }
+    }
+    for (const auto &arg : args) {
+      if (arg.getOperation() != nullptr) {
+        stack.push_back(arg.getOperation());
+      }
+    }
+  }
+}
+
+/**
+ * Runs the stages selected in `options` on the tape of `main_trace` and on the
+ * tapes of its atomic functions in `CodeGenData::traces`, and prints the
+ * number of operations of each tape after each stage. Constant folding and
+ * dead-output elimination record the tapes again from the functors of the
+ * traces, hence CppAD's optimizer runs last. Tapes without a functor (e.g.
+ * given as an `ADFun` from Python) are only optimized by CppAD.
+ */
+template <typename BaseScalar>
+void optimize_traces(FunctionTrace<BaseScalar> &main_trace,
+                     const TapeOptimizationOptions &options) {
+  auto &traces = *CodeGenData<BaseScalar>::traces;
+  const auto &order = *CodeGenData<BaseScalar>::invocation_order;
+  std::vector<FunctionTrace<BaseScalar> *> all_traces{&main_trace};
+  for (const auto &name : order) {
+    all_traces.push_back(&traces[name]);
+  }
+  std::map<std::string, std::vector<TapeOperationCount>> report;
+  // constant outputs of each tape, which are kept when it is recorded again
+  std::map<std::string, std::map<std::size_t, BaseScalar>> replacements;
+  for (auto *trace : all_traces) {
+    report[trace->name].push_back(count_operations("traced", *trace->tape));
+  }
+
+  if (options.fold_constants) {
+    for (auto *trace : all_traces) {
+      auto &constants = replacements[trace->name];
+      constants = constant_outputs(*trace->tape);
+      if (!constants.empty() && trace->functor) {
+        retape(*trace, constants);
+      }
+      report[trace->name].push_back(
+          count_operations("constant folding", *trace->tape));
+    }
+  }
+
+  if (options.eliminate_dead_outputs) {
+    std::map<std::string, std::set<std::size_t>> used;
+    for (auto *trace : all_traces) {
+      collect_used_atomic_outputs(*trace->tape, used);
+    }
+    // the main function keeps all of its outputs
+    for (std::size_t k = 1; k < all_traces.size(); ++k) {
+      FunctionTrace<BaseScalar> &trace = *all_traces[k];
+      const std::set<std::size_t> &used_outputs = used[trace.name];
+      auto &constants = replacements[trace.name];
+      bool has_dead_outputs = false;
+      for (int i = 0; i < trace.output_dim; ++i) {
+        if (used_outputs.count(i) == 0 && !trace.tape->Parameter(i)) {
+          constants[i] = BaseScalar(0);
+          has_dead_outputs = true;
+        }
+      }
+      if (has_dead_outputs && trace.functor) {
+        retape(trace, constants);
+      }
+    }
+    for (auto *trace : all_traces) {
+      report[trace->name].push_back(
+          count_operations("dead outputs", *trace->tape));
+    }
+  }
+
+  if (options.cppad_optimize) {
+    for (auto *trace : all_traces) {
+      trace->tape->optimize(options.cppad_optimize_options);
+      report[trace->name].push_back(
+          count_operations("CppAD optimize", *trace->tape));
+    }
+  }
+
+  std::cout << "Tape optimization (operations / variables):\n";
+  for (auto *trace : all_traces) {
+    std::cout << "  \"" << trace->name << "\":\n";
+    for (const auto &count : report[trace->name]) {
+      std::cout << "    " << std::left << std::setw(18) << count.stage
+                << std::right << std::setw(10) << count.operations << " / "
+                << count.variables << "\n";
+    }
+  }
+}
+}  // namespace autogen
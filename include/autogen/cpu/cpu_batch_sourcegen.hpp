@@ -0,0 +1,356 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "autogen/core/sparsity.hpp"
+#include "autogen/cuda/cuda_codegen.hpp"
+#include "cpu_function.hpp"
+
+namespace autogen {
+/**
+ * Common header of the C source files that are added to the CPU library.
+ */
+static inline std::string cpu_source_prelude(
+    const std::string &base_type_name) {
+  std::ostringstream code;
+  code << "#include <math.h>\n#include <stddef.h>\n#include <stdio.h>\n\n";
+  code << "typedef " << base_type_name << " Float;\n\n";
+  code << R"(#ifdef _WIN32
+#define MODULE_API __declspec(dllexport)
+#else
+#define MODULE_API
+#endif
+
+/* per-sample functions are local to this translation unit */
+#define __device__ static inline
+
+typedef struct {
+  int output_dim;
+  int local_input_dim;
+  int global_input_dim;
+  int accumulated_output;
+  int simd_width;
+} CpuFunctionMetaData;
+
+)";
+  return code.str();
+}
+
+/**
+ * Definition of `CpuFunctionMetaData` for exported headers, which may be
+ * included together in the same translation unit.
+ */
+static inline std::string cpu_export_meta_data() {
+  return R"(#ifndef AUTOGEN_CPU_FUNCTION_META_DATA
+#define AUTOGEN_CPU_FUNCTION_META_DATA
+typedef struct {
+  int output_dim;
+  int local_input_dim;
+  int global_input_dim;
+  int accumulated_output;
+  int simd_width;
+} CpuFunctionMetaData;
+#endif
+
+)";
+}
+
+/**
+ * Header of exported source bundles (see `GeneratedCodeGen::export_cpu()`),
+ * whose entry points are declared via the macro `api` (`static inline` unless
+ * defined before the inclusion). The helper macros are removed again by
+ * `cpu_export_epilogue()`, so that several exported functions can be
+ * included in the same translation unit.
+ */
+static inline std::string cpu_export_prelude(const std::string &base_type_name,
+                                             const std::string &api) {
+  std::ostringstream code;
+  code << "#include <math.h>\n#include <stddef.h>\n\n";
+  code << "#ifndef " << api << "\n";
+  code << "#define " << api << " static inline\n#endif\n";
+  code << "#define MODULE_API " << api << "\n";
+  code << "#define Float " << base_type_name << "\n";
+  code << "#define __device__ static inline\n\n";
+  code << cpu_export_meta_data();
+  return code.str();
+}
+
+static inline std::string cpu_export_epilogue() {
+  return "\n#undef MODULE_API\n#undef Float\n#undef __device__\n";
+}
+
+/**
+ * Generates a single C source file with batched entry points
+ * `<name>_forward_zero_batch`, `<name>_jacobian_batch` and (optionally)
+ * `<name>_value_and_jacobian_batch` that evaluate a function on a contiguous
+ * batch of samples.
+ *
+ * The per-sample code is generated by the kernel-only CUDA code generators,
+ * which call atomic functions directly instead of going through the atomic
+ * function bridge of CppADCodeGen. Compiled as C, these per-sample functions
+ * become `static inline` functions that the compiler can inline into the
+ * sample loop.
+ */
+template <class Base>
+class CpuBatchSourceGen {
+ protected:
+  /**
+   * Models to be contained in the source file, where the last one is the main
+   * model for which the batched functions are generated.
+   */
+  std::list<CudaModelSourceGen<Base> *> models_;
+
+  /**
+   * Sparsity pattern of the Jacobian of the main model for which the sparse
+   * Jacobian function is generated (if not empty).
+   */
+  SparsityPattern jacobian_sparsity_;
+
+ public:
+  CpuBatchSourceGen(CudaModelSourceGen<Base> *model) {
+    model->set_kernel_only(true);
+    models_.push_back(model);
+  }
+
+  CudaModelSourceGen<Base> *main_model() const { return models_.back(); }
+
+  /**
+   * Adds an atomic function model. Models have to be added in the reverse
+   * order of invocation, i.e. innermost functions first.
+   */
+  void add_model(CudaModelSourceGen<Base> *model) {
+    model->set_kernel_only(true);
+    auto it = models_.end();
+    std::advance(it, -1);
+    models_.insert(it, model);
+  }
+
+  /**
+   * Enables the generation of `<name>_sparse_jacobian_batch`, which computes
+   * the nonzero entries of the Jacobian of the main model in the CSR order of
+   * the given pattern, and `<name>_sparse_jacobian_pattern`, which returns the
+   * pattern.
+   */
+  void set_jacobian_sparsity(const SparsityPattern &pattern) {
+    jacobian_sparsity_ = pattern;
+  }
+
+  /**
+   * Generates the complete source code of the batch functions.
+   */
+  std::string generate_code() const {
+    return generate_code(cpu_source_prelude(main_model()->base_type_name()));
+  }
+
+  /**
+   * Generates the source code of the batch functions following the given
+   * prelude, which has to define `Float`, `MODULE_API`, `__device__` and
+   * `CpuFunctionMetaData`.
+   */
+  std::string generate_code(const std::string &prelude) const {
+    std::vector<std::pair<std::string, std::string>> sources;
+    std::ostringstream code;
+    code << prelude;
+    for (auto *cgen : models_) {
+      if (cgen->isCreateForwardZero()) {
+        code << cgen->forward_zero_source();
+      }
+      if (cgen->isCreateSparseForwardOne()) {
+        code << cgen->forward_one_source(sources);
+      }
+      if (cgen->isCreateReverseOne()) {
+        code << cgen->reverse_one_source(sources);
+      }
+      if (cgen->isCreateJacobian()) {
+        code << cgen->jacobian_source();
+      }
+    }
+
+    const auto *main = main_model();
+    const std::string &name = main->getName();
+    const std::size_t input_dim =
+        main->local_input_dim() + main->global_input_dim();
+    if (main->isCreateForwardZero()) {
+      emit_batch_function(code, name + "_forward_zero", main->output_dim());
+    }
+    if (main->isCreateJacobian()) {
+      emit_batch_function(code, name + "_jacobian",
+                          main->output_dim() * input_dim);
+    }
+    if (!jacobian_sparsity_.empty()) {
+      std::vector<std::size_t> rows, cols;
+      for (int row : jacobian_sparsity_.row_indices()) {
+        rows.push_back(static_cast<std::size_t>(row));
+      }
+      for (int col : jacobian_sparsity_.col_indices) {
+        cols.push_back(static_cast<std::size_t>(col));
+      }
+      code << main->sparse_jacobian_elements_source(rows, cols);
+      emit_batch_function(code, name + "_sparse_jacobian",
+                          jacobian_sparsity_.nnz());
+      emit_sparsity_function(code, name + "_sparse_jacobian_pattern",
+                             jacobian_sparsity_);
+    }
+    if (main->is_create_value_and_jacobian()) {
+      code << main->value_and_jacobian_source();
+      emit_batch_function(code, name + "_value_and_jacobian",
+                          main->output_dim() * (1 + input_dim));
+    }
+
+    std::map<std::string, std::string> files(sources.begin(), sources.end());
+    std::set<std::string> included;
+    return inline_includes(code.str(), files, included);
+  }
+
+  /**
+   * Generates the C declarations of the entry points defined by
+   * `generate_code()`, e.g. for the header of a static library that contains
+   * the generated code.
+   */
+  std::string generate_declarations() const {
+    const auto *main = main_model();
+    const std::string &name = main->getName();
+    const std::string float_type = main->base_type_name();
+    std::ostringstream code;
+    const auto declare_batch = [&](const std::string &function_name) {
+      const std::string batch_name = function_name + "_batch";
+      code << "CpuFunctionMetaData " << batch_name << "_meta(void);\n";
+      std::string fun_head_start = "void " + batch_name + "(";
+      std::string fun_arg_pad = std::string(fun_head_start.size(), ' ');
+      code << fun_head_start << "int num_samples,\n";
+      code << fun_arg_pad << float_type << " *out, int out_stride,\n";
+      code << fun_arg_pad << "const " << float_type
+           << " *local_input, int local_stride,\n";
+      code << fun_arg_pad << "const " << float_type
+           << " *global_input, int global_stride);\n\n";
+    };
+    if (main->isCreateForwardZero()) {
+      declare_batch(name + "_forward_zero");
+    }
+    if (main->isCreateJacobian()) {
+      declare_batch(name + "_jacobian");
+    }
+    if (!jacobian_sparsity_.empty()) {
+      declare_batch(name + "_sparse_jacobian");
+      std::string fun_head_start =
+          "void " + name + "_sparse_jacobian_pattern(";
+      std::string fun_arg_pad = std::string(fun_head_start.size(), ' ');
+      code << fun_head_start << "int *num_rows, int *num_cols, int *nnz,\n";
+      code << fun_arg_pad << "const int **row_offsets,\n";
+      code << fun_arg_pad << "const int **col_indices);\n\n";
+    }
+    if (main->is_create_value_and_jacobian()) {
+      declare_batch(name + "_value_and_jacobian");
+    }
+    return code.str();
+  }
+
+ protected:
+  void emit_batch_function(std::ostringstream &code,
+                           const std::string &function_name,
+                           std::size_t output_dim) const {
+    const auto *main = main_model();
+    const std::size_t global_input_dim = main->global_input_dim();
+    const std::string batch_name = function_name + "_batch";
+
+    code << "\nMODULE_API CpuFunctionMetaData " << batch_name << "_meta() {\n";
+    code << "  CpuFunctionMetaData data;\n";
+    code << "  data.output_dim = " << output_dim << ";\n";
+    code << "  data.local_input_dim = " << main->local_input_dim() << ";\n";
+    code << "  data.global_input_dim = " << global_input_dim << ";\n";
+    code << "  data.accumulated_output = 0;\n";
+    code << "  data.simd_width = 1;\n";
+    code << "  return data;\n}\n\n";
+
+    std::string fun_head_start = "MODULE_API void " + batch_name + "(";
+    std::string fun_arg_pad = std::string(fun_head_start.size(), ' ');
+    code << fun_head_start << "int num_samples,\n";
+    code << fun_arg_pad << "Float *out, int out_stride,\n";
+    code << fun_arg_pad << "const Float *local_input, int local_stride,\n";
+    code << fun_arg_pad << "const Float *global_input, int global_stride) {\n";
+    code << "  int i;\n";
+    code << "  for (i = 0; i < num_samples; ++i) {\n";
+    code << "    " << function_name << "(&out[(size_t)i * out_stride],\n";
+    code << "    " << std::string(function_name.size() + 1, ' ')
+         << "&local_input[(size_t)i * local_stride]";
+    if (global_input_dim > 0) {
+      code << ",\n    " << std::string(function_name.size() + 1, ' ')
+           << "&global_input[(size_t)i * global_stride]";
+    }
+    code << ");\n  }\n";
+    if (global_input_dim == 0) {
+      code << "  (void)global_input;\n  (void)global_stride;\n";
+    }
+    code << "}\n";
+  }
+
+  /**
+   * Emits a function that returns the given CSR pattern, stored in static
+   * arrays of the library.
+   */
+  static void emit_sparsity_function(std::ostringstream &code,
+                                     const std::string &function_name,
+                                     const SparsityPattern &pattern) {
+    const auto emit_array = [&code](const std::string &array_name,
+                                    const std::vector<int> &values) {
+      code << "static const int " << array_name << "[" << values.size() + 1
+           << "] = {";
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        code << (i % 16 == 0 ? "\n  " : " ") << values[i] << ",";
+      }
+      // trailing entry so that empty arrays remain valid C
+      code << "\n  0};\n";
+    };
+    code << "\n";
+    emit_array(function_name + "_row_offsets", pattern.row_offsets);
+    emit_array(function_name + "_col_indices", pattern.col_indices);
+    std::string fun_head_start = "MODULE_API void " + function_name + "(";
+    std::string fun_arg_pad = std::string(fun_head_start.size(), ' ');
+    code << fun_head_start << "int *num_rows, int *num_cols, int *nnz,\n";
+    code << fun_arg_pad << "const int **row_offsets,\n";
+    code << fun_arg_pad << "const int **col_indices) {\n";
+    code << "  *num_rows = " << pattern.num_rows << ";\n";
+    code << "  *num_cols = " << pattern.num_cols << ";\n";
+    code << "  *nnz = " << pattern.nnz() << ";\n";
+    code << "  *row_offsets = " << function_name << "_row_offsets;\n";
+    code << "  *col_indices = " << function_name << "_col_indices;\n";
+    code << "}\n";
+  }
+
+  /**
+   * Replaces `#include "<file>"` directives of generated source files by the
+   * file contents, so that the batch functions end up in one translation
+   * unit.
+   */
+  static std::string inline_includes(
+      const std::string &source,
+      const std::map<std::string, std::string> &files,
+      std::set<std::string> &included) {
+    static const std::string directive = "#include \"";
+    std::istringstream input(source);
+    std::ostringstream output;
+    std::string line;
+    while (std::getline(input, line)) {
+      if (line.rfind(directive, 0) == 0) {
+        const std::size_t end = line.find('"', directive.size());
+        std::string filename =
+            line.substr(directive.size(), end - directive.size());
+        auto it = files.find(filename);
+        if (it != files.end()) {
+          if (included.insert(filename).second) {
+            output << inline_includes(it->second, files, included) << "\n";
+          }
+          continue;
+        }
+      }
+      output << line << "\n";
+    }
+    return output.str();
+  }
+};
+}  // namespace autogen
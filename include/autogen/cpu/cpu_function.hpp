@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include "autogen/core/base.hpp"
+
+namespace autogen {
+struct CpuFunctionMetaData {
+  int output_dim;
+  int local_input_dim;
+  int global_input_dim;
+  int accumulated_output;
+  int simd_width;
+};
+
+template <typename Scalar>
+using CpuBatchFunctionPtrT = void (*)(int, Scalar *, int, const Scalar *, int,
+                                      const Scalar *, int);
+
+template <typename Scalar>
+using CpuSimdFunctionPtrT = void (*)(int, Scalar *, const Scalar *,
+                                     const Scalar *);
+
+using CpuMetaDataFunctionPtrT = CpuFunctionMetaData (*)();
+
+// returns dimensions and CSR indices of a sparsity pattern stored in a library
+using CpuSparsityFunctionPtrT = void (*)(int *, int *, int *, const int **,
+                                         const int **);
+
+/**
+ * Batched entry point of a compiled CPU library that evaluates a function on
+ * a contiguous batch of samples in a single call.
+ */
+template <typename Scalar>
+struct CpuBatchFunction {
+  using FunctionPtrT = CpuBatchFunctionPtrT<Scalar>;
+  std::string function_name;
+
+ protected:
+  CpuFunctionMetaData meta_data_{};
+  FunctionPtrT fun_{nullptr};
+
+ public:
+  CpuBatchFunction() = default;
+
+  /**
+   * Loads the batched function `function_name` and its meta data function
+   * from the given library, which has to provide
+   * `void *loadFunction(const std::string&, bool required)`. The function is
+   * marked unavailable if the library does not contain it (e.g. when it was
+   * compiled without batch kernels).
+   */
+  template <typename Library>
+  CpuBatchFunction(const std::string &function_name, Library &library)
+      : function_name(function_name) {
+    fun_ = (FunctionPtrT)library.loadFunction(function_name, false);
+    if (!fun_) {
+      return;
+    }
+    auto meta_data_fun = (CpuMetaDataFunctionPtrT)library.loadFunction(
+        function_name + "_meta", true);
+    meta_data_ = meta_data_fun();
+  }
+
+  bool is_available() const { return fun_ != nullptr; }
+
+  /**
+   * Raw pointer to the compiled function, or `nullptr` if it is unavailable.
+   */
+  FunctionPtrT function_ptr() const { return fun_; }
+
+  /**
+   * Global input dimension.
+   */
+  int global_input_dim() const { return meta_data_.global_input_dim; }
+  /**
+   * Input dimension per sample.
+   */
+  int local_input_dim() const { return meta_data_.local_input_dim; }
+  /**
+   * Output dimension per sample.
+   */
+  int output_dim() const { return meta_data_.output_dim; }
+  /**
+   * Determines whether the output is accumulated over all samples.
+   */
+  bool accumulated_output() const { return meta_data_.accumulated_output != 0; }
+
+  inline void operator()(int num_samples, BatchView<const Scalar> local_inputs,
+                         BatchView<Scalar> outputs,
+                         BatchView<const Scalar> global_input = {}) const {
+    if (!fun_) {
+      throw std::runtime_error("Function \"" + function_name +
+                               "\" is not available.");
+    }
+    fun_(num_samples, outputs.data, outputs.stride, local_inputs.data,
+         local_inputs.stride, global_input.data, global_input.stride);
+  }
+};
+
+/**
+ * SIMD entry point of a compiled CPU library that evaluates a function on
+ * blocks of `simd_width()` samples stored in structure-of-arrays layout (see
+ * `aos_to_soa()`).
+ */
+template <typename Scalar>
+struct CpuSimdFunction {
+  using FunctionPtrT = CpuSimdFunctionPtrT<Scalar>;
+  std::string function_name;
+
+ protected:
+  CpuFunctionMetaData meta_data_{};
+  FunctionPtrT fun_{nullptr};
+
+ public:
+  CpuSimdFunction() = default;
+
+  template <typename Library>
+  CpuSimdFunction(const std::string &function_name, Library &library)
+      : function_name(function_name) {
+    fun_ = (FunctionPtrT)library.loadFunction(function_name, false);
+    if (!fun_) {
+      return;
+    }
+    auto meta_data_fun = (CpuMetaDataFunctionPtrT)library.loadFunction(
+        function_name + "_meta", true);
+    meta_data_ = meta_data_fun();
+  }
+
+  bool is_available() const { return fun_ != nullptr; }
+
+  int global_input_dim() const { return meta_data_.global_input_dim; }
+  int local_input_dim() const { return meta_data_.local_input_dim; }
+  int output_dim() const { return meta_data_.output_dim; }
+  /**
+   * Number of samples per block.
+   */
+  int simd_width() const { return meta_data_.simd_width; }
+
+  inline void operator()(int num_blocks, const Scalar *local_inputs,
+                         Scalar *outputs,
+                         const Scalar *global_input = nullptr) const {
+    if (!fun_) {
+      throw std::runtime_error("Function \"" + function_name +
+                               "\" is not available.");
+    }
+    fun_(num_blocks, outputs, local_inputs, global_input);
+  }
+};
+}  // namespace autogen
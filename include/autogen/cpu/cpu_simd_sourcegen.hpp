@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cppad/cg.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "autogen/cuda/cuda_language.hpp"
+#include "autogen/cuda/cuda_variable_name_gen.hpp"
+
+namespace autogen {
+/**
+ * Variable name generator for SIMD-across-samples code where the inputs and
+ * outputs of a block of `width` samples are stored as structure of arrays,
+ * i.e. entry `i` of sample `k` within the block is located at
+ * `i * width + k`. Global inputs are shared by all samples of the block.
+ */
+template <class Base>
+class SimdVariableNameGenerator : public CudaVariableNameGenerator<Base> {
+ protected:
+  std::size_t width_;
+  // name of the lane index within the block
+  std::string lane_name_;
+
+ public:
+  SimdVariableNameGenerator(std::size_t global_input_dim, std::size_t width,
+                            std::string lane_name = "k")
+      : CudaVariableNameGenerator<Base>(global_input_dim),
+        width_(width),
+        lane_name_(std::move(lane_name)) {}
+
+  std::size_t width() const { return width_; }
+
+  std::string generateDependent(size_t index) override {
+    this->_ss.clear();
+    this->_ss.str("");
+    this->_ss << this->_depName << "[" << index * width_ << " + " << lane_name_
+              << "]";
+    return this->_ss.str();
+  }
+
+  std::string generateIndependent(
+      const CppAD::cg::OperationNode<Base> &independent,
+      size_t id) override {
+    if (id - 1 < this->global_input_dim_) {
+      return CudaVariableNameGenerator<Base>::generateIndependent(independent,
+                                                                  id);
+    }
+    this->_ss.clear();
+    this->_ss.str("");
+    this->_ss << this->local_name_ << "["
+              << (id - 1 - this->global_input_dim_) * width_ << " + "
+              << lane_name_ << "]";
+    return this->_ss.str();
+  }
+
+  // inputs are interleaved with other samples, hence they must not be copied
+  // via loops over consecutive indices
+  bool isConsecutiveInIndepArray(
+      const CppAD::cg::OperationNode<Base> &indepFirst, size_t idFirst,
+      const CppAD::cg::OperationNode<Base> &indepSecond,
+      size_t idSecond) override {
+    return false;
+  }
+
+  bool isInSameIndependentArray(const CppAD::cg::OperationNode<Base> &indep1,
+                                size_t id1,
+                                const CppAD::cg::OperationNode<Base> &indep2,
+                                size_t id2) override {
+    return false;
+  }
+};
+
+/**
+ * Generates C functions that evaluate a function on blocks of `width` samples
+ * stored in structure-of-arrays layout. The per-sample code is wrapped in a
+ * `#pragma omp simd` loop over the samples of a block, so that every
+ * temporary variable becomes a `width`-wide vector register.
+ *
+ * Functions that call atomic functions are not supported.
+ */
+template <class Base>
+class CpuSimdSourceGen : public CppAD::cg::ModelCSourceGen<Base> {
+  using CGBase = CppAD::cg::CG<Base>;
+
+ protected:
+  std::size_t global_input_dim_{0};
+  std::size_t width_{8};
+
+ public:
+  CpuSimdSourceGen(CppAD::ADFun<CGBase> &fun, std::string model,
+                   std::size_t width)
+      : CppAD::cg::ModelCSourceGen<Base>(fun, model), width_(width) {}
+
+  std::size_t &global_input_dim() { return global_input_dim_; }
+  const std::size_t &global_input_dim() const { return global_input_dim_; }
+
+  std::size_t local_input_dim() const {
+    return this->_fun.Domain() - global_input_dim_;
+  }
+  std::size_t output_dim() const { return this->_fun.Range(); }
+  std::size_t width() const { return width_; }
+
+  std::string base_type_name() const { return this->_baseTypeName; }
+
+  /**
+   * Generates the function `<name>_forward_zero_simd` for the zero-order
+   * forward pass.
+   */
+  std::string forward_zero_source() {
+    const std::string jobName = "model (zero-order forward, SIMD)";
+    this->startingJob("'" + jobName + "'", CppAD::cg::JobTimer::GRAPH);
+
+    CppAD::cg::CodeHandler<Base> handler;
+    handler.setJobTimer(this->_jobTimer);
+
+    std::vector<CGBase> indVars(this->_fun.Domain());
+    handler.makeVariables(indVars);
+    if (this->_x.size() > 0) {
+      for (std::size_t i = 0; i < indVars.size(); i++) {
+        indVars[i].setValue(this->_x[i]);
+      }
+    }
+
+    std::vector<CGBase> dep;
+    if (this->_loopTapes.empty()) {
+      dep = this->_fun.Forward(0, indVars);
+    } else {
+      dep = this->prepareForward0WithLoops(handler, indVars);
+    }
+    this->finishedJob();
+
+    return function_source(std::string(this->_name) + "_forward_zero_simd",
+                           handler, dep, jobName);
+  }
+
+  /**
+   * Generates the function `<name>_jacobian_simd` for the dense Jacobian.
+   */
+  std::string jacobian_source() {
+    const std::string jobName = "Jacobian (SIMD)";
+    this->startingJob("'" + jobName + "'", CppAD::cg::JobTimer::GRAPH);
+
+    CppAD::cg::CodeHandler<Base> handler;
+    handler.setJobTimer(this->_jobTimer);
+
+    std::vector<CGBase> indVars(this->_fun.Domain());
+    handler.makeVariables(indVars);
+    if (this->_x.size() > 0) {
+      for (std::size_t i = 0; i < indVars.size(); i++) {
+        indVars[i].setValue(this->_x[i]);
+      }
+    }
+
+    std::vector<CGBase> jac = this->_fun.Jacobian(indVars);
+    this->finishedJob();
+
+    return function_source(std::string(this->_name) + "_jacobian_simd",
+                           handler, jac, jobName);
+  }
+
+ protected:
+  std::string function_source(const std::string &function_name,
+                              CppAD::cg::CodeHandler<Base> &handler,
+                              std::vector<CGBase> &dep,
+                              const std::string &jobName) {
+    if (this->isAtomicsUsed()) {
+      throw std::runtime_error("SIMD code generation for function \"" +
+                               this->_name +
+                               "\" failed: atomic functions are not "
+                               "supported.");
+    }
+
+    LanguageCuda<Base> langC(false);
+    langC.setMaxOperationsPerAssignment(this->_maxOperationsPerAssignment);
+    langC.setParameterPrecision(this->_parameterPrecision);
+    // set function name to empty string so that only the body gets generated
+    langC.setGenerateFunction("");
+
+    std::ostringstream body;
+    SimdVariableNameGenerator<Base> nameGen(global_input_dim_, width_);
+    handler.generateCode(body, langC, dep, nameGen, this->_atomicFunctions,
+                         jobName);
+    // constants are hoisted out of the SIMD loop
+    std::ostringstream constants;
+    langC.print_constants(constants);
+
+    const std::size_t output_dim = dep.size();
+    std::ostringstream code;
+    code << "\nMODULE_API CpuFunctionMetaData " << function_name
+         << "_meta() {\n";
+    code << "  CpuFunctionMetaData data;\n";
+    code << "  data.output_dim = " << output_dim << ";\n";
+    code << "  data.local_input_dim = " << local_input_dim() << ";\n";
+    code << "  data.global_input_dim = " << global_input_dim_ << ";\n";
+    code << "  data.accumulated_output = 0;\n";
+    code << "  data.simd_width = " << width_ << ";\n";
+    code << "  return data;\n}\n\n";
+
+    std::string fun_head_start = "MODULE_API void " + function_name + "(";
+    std::string fun_arg_pad = std::string(fun_head_start.size(), ' ');
+    code << fun_head_start << "int num_blocks,\n";
+    code << fun_arg_pad << "Float *out,\n";
+    code << fun_arg_pad << "const Float *local_input,\n";
+    code << fun_arg_pad << "const Float *global_input) {\n";
+    code << constants.str();
+    if (global_input_dim_ > 0) {
+      code << "  const Float *x = global_input;  /* global input */\n";
+    } else {
+      code << "  (void)global_input;\n";
+    }
+    code << "  int b, k;\n";
+    code << "  for (b = 0; b < num_blocks; ++b) {\n";
+    code << "    const Float *xj = &local_input[(size_t)b * "
+         << local_input_dim() * width_ << "];\n";
+    code << "    Float *y = &out[(size_t)b * " << output_dim * width_
+         << "];\n";
+    code << "#pragma omp simd\n";
+    code << "    for (k = 0; k < " << width_ << "; ++k) {\n";
+    auto &info = langC.getInfo();
+    code << langC.generateTemporaryVariableDeclaration(
+        false, false, info->atomicFunctionsMaxForward,
+        info->atomicFunctionsMaxReverse);
+    code << body.str();
+    code << "    }\n  }\n}\n";
+
+    std::size_t temporary_dim = nameGen.getMaxTemporaryVariableID() + 1 -
+                                nameGen.getMinTemporaryVariableID();
+    std::cout << "Code generated for SIMD function \"" << function_name
+              << "\" of width " << width_ << " with " << temporary_dim
+              << " temporary variables.\n";
+    return code.str();
+  }
+};
+}  // namespace autogen
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+
+#include "autogen/core/base.hpp"
+
+namespace autogen {
+/**
+ * Number of blocks of `width` samples that are needed to store `num_samples`
+ * samples in structure-of-arrays layout.
+ */
+static inline int soa_num_blocks(int num_samples, int width) {
+  return (num_samples + width - 1) / width;
+}
+
+/**
+ * Transposes the rows of dimension `dim` of `num_samples` samples (array of
+ * structures) into blocks of `width` samples (structure of arrays), where
+ * entry `i` of sample `k` in block `b` is stored at
+ * `soa[(b * dim + i) * width + k]`. The trailing block is padded with copies of
+ * the last sample so that the padded lanes evaluate to finite values.
+ *
+ * `soa` has to hold `soa_num_blocks(num_samples, width) * width * dim` entries.
+ */
+template <typename Scalar>
+void aos_to_soa(int num_samples, int dim, int width,
+                BatchView<const Scalar> aos, Scalar *soa) {
+  const int num_blocks = soa_num_blocks(num_samples, width);
+  for (int b = 0; b < num_blocks; ++b) {
+    Scalar *block = soa + static_cast<std::ptrdiff_t>(b) * dim * width;
+    for (int k = 0; k < width; ++k) {
+      const Scalar *row = aos[std::min(b * width + k, num_samples - 1)];
+      for (int i = 0; i < dim; ++i) {
+        block[i * width + k] = row[i];
+      }
+    }
+  }
+}
+
+/**
+ * Inverse of `aos_to_soa()`, which writes the first `num_samples` samples of
+ * the structure-of-arrays blocks back to the rows of `aos`.
+ */
+template <typename Scalar>
+void soa_to_aos(int num_samples, int dim, int width, const Scalar *soa,
+                BatchView<Scalar> aos) {
+  for (int s = 0; s < num_samples; ++s) {
+    const int b = s / width;
+    const int k = s % width;
+    const Scalar *block = soa + static_cast<std::ptrdiff_t>(b) * dim * width;
+    Scalar *row = aos[s];
+    for (int i = 0; i < dim; ++i) {
+      row[i] = block[i * width + k];
+    }
+  }
+}
+}  // namespace autogen
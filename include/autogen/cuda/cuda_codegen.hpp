@@ -26,6 +26,12 @@ class CudaModelSourceGen : public CppAD::cg::ModelCSourceGen<Base> {
    */
   bool kernel_only_{false};
 
+  /**
+   * Whether to generate the fused function that evaluates the outputs and the
+   * Jacobian at once (see `value_and_jacobian_source()`).
+   */
+  bool create_value_and_jacobian_{false};
+
  public:
   CudaModelSourceGen(CppAD::ADFun<CppAD::cg::CG<Base>> &fun, std::string model,
                      bool kernel_only = false)
@@ -45,6 +51,13 @@ class CudaModelSourceGen : public CppAD::cg::ModelCSourceGen<Base> {
   bool is_kernel_only() const { return kernel_only_; }
   void set_kernel_only(bool option) { kernel_only_ = option; }
 
+  bool is_create_value_and_jacobian() const {
+    return create_value_and_jacobian_;
+  }
+  void set_create_value_and_jacobian(bool option) {
+    create_value_and_jacobian_ = option;
+  }
+
   AccumulationMethod &jacobian_acc_method() { return jac_acc_method_; }
   const AccumulationMethod &jacobian_acc_method() const {
     return jac_acc_method_;
@@ -76,8 +89,6 @@ class CudaModelSourceGen : public CppAD::cg::ModelCSourceGen<Base> {
   }
 
   std::string sparse_jacobian_source() {
-    const std::string jobName = "sparse Jacobian";
-
     if (jac_local_input_sparsity_.empty() &&
         jac_global_input_sparsity_.empty()) {
       // assume dense Jacobian
@@ -104,6 +115,20 @@ class CudaModelSourceGen : public CppAD::cg::ModelCSourceGen<Base> {
         cols.push_back(input_i + global_input_dim_);
       }
     }
+    return sparse_jacobian_elements_source(rows, cols);
+  }
+
+  /**
+   * Generates the function `<name>_sparse_jacobian` that computes the given
+   * Jacobian elements, where `cols` refer to the full input vector (global
+   * input followed by the local input). The output holds the elements in the
+   * order in which they are provided.
+   */
+  std::string sparse_jacobian_elements_source(
+      const std::vector<std::size_t> &rows,
+      const std::vector<std::size_t> &cols) {
+    const std::string jobName = "sparse Jacobian";
+
     this->setCustomSparseJacobianElements(rows, cols);
     this->determineJacobianSparsity();
 
@@ -244,6 +269,11 @@ class CudaModelSourceGen : public CppAD::cg::ModelCSourceGen<Base> {
    */
   std::string forward_zero_source();
 
+  /**
+   * Generate CUDA library code for the fused forward zero pass and Jacobian.
+   */
+  std::string value_and_jacobian_source();
+
   /**
    * Generate CUDA library code for the forward one pass.
    */
@@ -281,4 +311,5 @@ class CudaModelSourceGen : public CppAD::cg::ModelCSourceGen<Base> {
 #include "cuda_codegen_for0.hpp"
 #include "cuda_codegen_for1.hpp"
 #include "cuda_codegen_jacobian.hpp"
+#include "cuda_codegen_value_jacobian.hpp"
 #include "cuda_codegen_rev1.hpp"
\ No newline at end of file
@@ -0,0 +1,101 @@
+namespace autogen {
+
+/**
+ * Generate code for the fused zero-order forward pass and Jacobian, whose
+ * output holds the function values followed by the row-major Jacobian.
+ * The Jacobian is assembled from first-order forward or reverse sweeps on top
+ * of the zero-order forward pass, so that both parts share the operations of
+ * the forward pass.
+ */
+template <class Base>
+std::string CudaModelSourceGen<Base>::value_and_jacobian_source() {
+  const std::string jobName = "value and Jacobian";
+
+  const std::size_t n = this->_fun.Domain();
+  const std::size_t m = this->_fun.Range();
+
+  this->startingJob("'" + jobName + "'", CppAD::cg::JobTimer::GRAPH);
+
+  CppAD::cg::CodeHandler<Base> handler;
+  handler.setJobTimer(this->_jobTimer);
+
+  std::vector<CGBase> indVars(n);
+  handler.makeVariables(indVars);
+  if (this->_x.size() > 0) {
+    for (size_t i = 0; i < n; i++) {
+      indVars[i].setValue(this->_x[i]);
+    }
+  }
+
+  std::vector<CGBase> dep(m + m * n);
+  std::vector<CGBase> value = this->_fun.Forward(0, indVars);
+  std::copy(value.begin(), value.end(), dep.begin());
+  // the sweeps reuse the zero-order Taylor coefficients of the forward pass
+  if (n <= m) {
+    std::vector<CGBase> dx(n, CGBase(0)), dy;
+    for (std::size_t j = 0; j < n; ++j) {
+      dx[j] = CGBase(1);
+      dy = this->_fun.Forward(1, dx);
+      dx[j] = CGBase(0);
+      for (std::size_t i = 0; i < m; ++i) {
+        dep[m + i * n + j] = dy[i];
+      }
+    }
+  } else {
+    std::vector<CGBase> w(m, CGBase(0)), dw;
+    for (std::size_t i = 0; i < m; ++i) {
+      w[i] = CGBase(1);
+      dw = this->_fun.Reverse(1, w);
+      w[i] = CGBase(0);
+      for (std::size_t j = 0; j < n; ++j) {
+        dep[m + i * n + j] = dw[j];
+      }
+    }
+  }
+
+  this->finishedJob();
+
+  LanguageCuda<Base> langC;
+  langC.setMaxAssignmentsPerFunction(this->_maxAssignPerFunc, &this->_sources);
+  langC.setMaxOperationsPerAssignment(this->_maxOperationsPerAssignment);
+  langC.setParameterPrecision(this->_parameterPrecision);
+  // set function name to empty string so that only the body gets generated
+  langC.setGenerateFunction("");
+
+  std::ostringstream code;
+  CudaVariableNameGenerator<Base> nameGen(global_input_dim_);
+
+  handler.generateCode(code, langC, dep, nameGen, this->_atomicFunctions,
+                       jobName);
+  langC.print_constants(code);
+
+  std::size_t temporary_dim = nameGen.getMaxTemporaryVariableID() + 1 -
+                              nameGen.getMinTemporaryVariableID();
+  if (temporary_dim == 0) {
+    std::cerr << "Warning: generated code for value and Jacobian of \""
+              << this->_name << "\" has no temporary variables.\n";
+  } else {
+    std::cout << "Code generated for value and Jacobian of \"" << this->_name
+              << "\" with " << temporary_dim << " temporary variables.\n";
+  }
+
+  std::ostringstream complete;
+
+  CudaFunctionSourceGen generator(
+      std::string(this->_name) + "_value_and_jacobian", local_input_dim(),
+      global_input_dim_, static_cast<int>(dep.size()), ACCUMULATE_NONE);
+
+  if (!kernel_only_) {
+    generator.emit_header(complete);
+  }
+  generator.emit_kernel(complete, code, langC, kernel_only_);
+  if (!kernel_only_) {
+    generator.emit_allocation_functions(complete);
+    generator.emit_send_functions(complete);
+    generator.emit_kernel_launch(complete);
+  }
+
+  return complete.str();
+}
+
+}  // namespace autogen
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+#include <stdexcept>
+#include <string>
+
+#ifdef USE_EIGEN
+#include <Eigen/Core>
+#endif
+
+#include "autogen.hpp"
+
+namespace autogen {
+/**
+ * Variant of `Generated` whose input and output dimensions are fixed at
+ * compile time. Inputs, outputs and Jacobians are passed as `std::array`s (or
+ * fixed-size Eigen types if `USE_EIGEN` is defined) whose sizes are checked
+ * via `static_assert`. After the first evaluation has compiled the function,
+ * evaluations of the compiled CPU code neither allocate memory nor discover
+ * dimensions at runtime.
+ *
+ * All inputs are local inputs, i.e. the global input dimension is zero.
+ */
+template <template <typename> typename Functor, int InputDim, int OutputDim,
+          typename BaseScalar = double>
+struct GeneratedFixed : public Generated<Functor, BaseScalar> {
+  static_assert(InputDim > 0, "The input dimension must be positive.");
+  static_assert(OutputDim > 0, "The output dimension must be positive.");
+
+  using Input = std::array<BaseScalar, InputDim>;
+  using Output = std::array<BaseScalar, OutputDim>;
+  // row-major Jacobian
+  using Jacobian = std::array<BaseScalar, OutputDim * InputDim>;
+
+  static_assert(sizeof(Input) == InputDim * sizeof(BaseScalar) &&
+                    sizeof(Output) == OutputDim * sizeof(BaseScalar),
+                "Arrays of inputs and outputs have to be contiguous.");
+
+#ifdef USE_EIGEN
+  using InputVector = Eigen::Matrix<BaseScalar, InputDim, 1>;
+  using OutputVector = Eigen::Matrix<BaseScalar, OutputDim, 1>;
+  // Eigen does not allow row-major matrices with a single column
+  using JacobianMatrix =
+      Eigen::Matrix<BaseScalar, OutputDim, InputDim,
+                    InputDim == 1 ? Eigen::ColMajor : Eigen::RowMajor>;
+#endif
+
+ protected:
+  using Base = Generated<Functor, BaseScalar>;
+
+  // whether the generator of the current mode has been evaluated once
+  bool initialized_{false};
+
+ public:
+  using Base::jacobian;
+  using Base::operator();
+
+  template <typename... Args>
+  GeneratedFixed(const std::string& name, Args&&... args)
+      : Base(name, std::forward<Args>(args)...) {
+    this->local_input_dim_ = InputDim;
+    this->output_dim_ = OutputDim;
+  }
+
+  static constexpr int input_dim() { return InputDim; }
+  static constexpr int local_input_dim() { return InputDim; }
+  static constexpr int output_dim() { return OutputDim; }
+
+  void set_mode(GenerationMode mode) {
+    initialized_ = false;
+    Base::set_mode(mode);
+  }
+
+  void discard_library() {
+    initialized_ = false;
+    Base::discard_library();
+  }
+
+  // the input split is fixed
+  void set_global_input_dim(int) = delete;
+  void set_local_input_dim(int) = delete;
+
+  template <std::size_t N, std::size_t M>
+  void operator()(const std::array<BaseScalar, N>& input,
+                  std::array<BaseScalar, M>& output) {
+    static_assert(N == InputDim, "Input array has the wrong dimension.");
+    static_assert(M == OutputDim, "Output array has the wrong dimension.");
+    evaluate_fixed_(input.data(), [&](GeneratedBaseT<BaseScalar>& gen) {
+      gen(input.data(), output.data());
+    });
+  }
+
+  template <std::size_t N, std::size_t M>
+  void jacobian(const std::array<BaseScalar, N>& input,
+                std::array<BaseScalar, M>& jac) {
+    static_assert(N == InputDim, "Input array has the wrong dimension.");
+    static_assert(M == OutputDim * InputDim,
+                  "Jacobian array has the wrong dimension.");
+    evaluate_fixed_(input.data(), [&](GeneratedBaseT<BaseScalar>& gen) {
+      gen.jacobian(input.data(), jac.data());
+    });
+  }
+
+  /**
+   * Vectorized forward pass on `num_samples` consecutive input and output
+   * arrays.
+   */
+  template <std::size_t N, std::size_t M>
+  void operator()(int num_samples, const std::array<BaseScalar, N>* inputs,
+                  std::array<BaseScalar, M>* outputs) {
+    static_assert(N == InputDim, "Input array has the wrong dimension.");
+    static_assert(M == OutputDim, "Output array has the wrong dimension.");
+    if (num_samples <= 0) {
+      return;
+    }
+    evaluate_fixed_(inputs[0].data(), [&](GeneratedBaseT<BaseScalar>& gen) {
+      gen(num_samples, {inputs[0].data(), InputDim},
+          {outputs[0].data(), OutputDim});
+    });
+  }
+
+  /**
+   * Vectorized Jacobian on `num_samples` consecutive input and Jacobian
+   * arrays.
+   */
+  template <std::size_t N, std::size_t M>
+  void jacobian(int num_samples, const std::array<BaseScalar, N>* inputs,
+                std::array<BaseScalar, M>* jacs) {
+    static_assert(N == InputDim, "Input array has the wrong dimension.");
+    static_assert(M == OutputDim * InputDim,
+                  "Jacobian array has the wrong dimension.");
+    if (num_samples <= 0) {
+      return;
+    }
+    evaluate_fixed_(inputs[0].data(), [&](GeneratedBaseT<BaseScalar>& gen) {
+      gen.jacobian(num_samples, {inputs[0].data(), InputDim},
+                   {jacs[0].data(), OutputDim * InputDim});
+    });
+  }
+
+#ifdef USE_EIGEN
+  void operator()(const InputVector& input, OutputVector& output) {
+    evaluate_fixed_(input.data(), [&](GeneratedBaseT<BaseScalar>& gen) {
+      gen(input.data(), output.data());
+    });
+  }
+
+  void jacobian(const InputVector& input, JacobianMatrix& jac) {
+    evaluate_fixed_(input.data(), [&](GeneratedBaseT<BaseScalar>& gen) {
+      gen.jacobian(input.data(), jac.data());
+    });
+  }
+#endif
+
+ protected:
+  /**
+   * Calls `fun` on the generator of the current mode (or on the fallback tape
+   * during a background compilation). The first call compiles the function
+   * (if necessary) via a regular evaluation, which also verifies that the
+   * functor produces `OutputDim` outputs.
+   */
+  template <typename Fun>
+  void evaluate_fixed_(const BaseScalar* input, Fun&& fun) {
+    if (!initialized_ ||
+        (!this->is_compiled() && !this->use_fallback_.load())) {
+      std::vector<BaseScalar> input_vec(input, input + InputDim),
+          output_vec(OutputDim);
+      Base::operator()(input_vec, output_vec);
+      if (static_cast<int>(output_vec.size()) != OutputDim) {
+        throw std::runtime_error(
+            "Function \"" + this->name + "\" has " +
+            std::to_string(output_vec.size()) + " outputs, but " +
+            std::to_string(OutputDim) + " are expected.");
+      }
+      initialized_ = true;
+    }
+    this->evaluate_(fun);
+  }
+};
+}  // namespace autogen
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "filesystem.hpp"
+#include "system.hpp"
+
+#if AUTOGEN_SYSTEM_WIN
+#include <process.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#ifndef AUTOGEN_VERSION
+// part of every cache key, so that libraries which were compiled from code
+// generated by a different version are not reused
+#define AUTOGEN_VERSION "0.0.1"
+#endif
+
+namespace autogen {
+/**
+ * Incremental 64-bit FNV-1a hash.
+ */
+struct Hasher {
+  std::uint64_t value{14695981039346656037ull};
+
+  Hasher &add_bytes(const void *data, std::size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      value = (value ^ bytes[i]) * 1099511628211ull;
+    }
+    return *this;
+  }
+
+  template <typename T>
+  Hasher &add(const T &v) {
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                  "Only arithmetic types and enums can be hashed bytewise.");
+    return add_bytes(&v, sizeof(T));
+  }
+
+  Hasher &add(const std::string &s) {
+    // the length separates consecutive strings
+    add(s.size());
+    return add_bytes(s.data(), s.size());
+  }
+
+  std::string hex() const {
+    static const char *digits = "0123456789abcdef";
+    std::string result(16, '0');
+    for (int i = 0; i < 16; ++i) {
+      result[15 - i] = digits[(value >> (4 * i)) & 0xf];
+    }
+    return result;
+  }
+};
+
+/**
+ * Directory of compiled libraries that are addressed by a hash of everything
+ * their code depends on (see `GeneratedCodeGen::cache_directory`), so that
+ * identical functions are only compiled once across processes.
+ *
+ * Entries are written to a temporary file and atomically renamed into place,
+ * so that a library is never loaded while it is being written. Processes that
+ * miss the same entry concurrently serialize its compilation via `lock()`.
+ */
+class CompilationCache {
+  std::string directory_;
+
+ public:
+  /**
+   * Opens the cache in the given directory, which is created if it does not
+   * exist yet.
+   */
+  explicit CompilationCache(const std::string &directory) {
+    namespace fs = std::filesystem;
+    fs::create_directories(directory);
+    directory_ = fs::absolute(directory).string();
+  }
+
+  /**
+   * Cache directory given by the environment variable `AUTOGEN_CACHE_DIR`, or
+   * an empty string if it is not set.
+   */
+  static std::string directory_from_environment() {
+    const char *dir = std::getenv("AUTOGEN_CACHE_DIR");
+    return dir ? std::string(dir) : std::string();
+  }
+
+  const std::string &directory() const { return directory_; }
+
+  /**
+   * Path of the entry `key` with the file extension `ext`.
+   */
+  std::string path(const std::string &key, const std::string &ext) const {
+    return (std::filesystem::path(directory_) / (key + ext)).string();
+  }
+
+  bool contains(const std::string &key, const std::string &ext) const {
+    return std::filesystem::exists(path(key, ext));
+  }
+
+  /**
+   * Copies `file` into the cache as the entry `key` with the file extension
+   * `ext`, replacing an existing entry atomically.
+   */
+  void store(const std::string &key, const std::string &ext,
+             const std::string &file) const {
+    namespace fs = std::filesystem;
+    const fs::path target = path(key, ext);
+    // the temporary file has to be on the same file system for the rename to
+    // be atomic, and its name has to be unique among the threads of all
+    // processes that store the same entry
+    static std::atomic<std::uint64_t> next_temp_id{0};
+    fs::path temp = target;
+    temp += ".tmp" + std::to_string(process_id_()) + "_" +
+            std::to_string(next_temp_id++);
+    fs::copy_file(file, temp, fs::copy_options::overwrite_existing);
+    fs::rename(temp, target);
+  }
+
+  /**
+   * Exclusive lock on a cache entry that is held by at most one process (and
+   * one `Lock` instance within a process) at a time. The lock is released when
+   * the instance is destroyed.
+   */
+  class Lock {
+#if AUTOGEN_SYSTEM_WIN
+    HANDLE handle_{INVALID_HANDLE_VALUE};
+#else
+    int fd_{-1};
+#endif
+
+   public:
+    Lock() = default;
+
+    explicit Lock(const std::string &lock_file) {
+#if AUTOGEN_SYSTEM_WIN
+      handle_ = CreateFileA(lock_file.c_str(), GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+      OVERLAPPED overlapped{};
+      if (handle_ == INVALID_HANDLE_VALUE ||
+          !LockFileEx(handle_, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD,
+                      &overlapped)) {
+        release_();
+        throw std::runtime_error("Failed to lock \"" + lock_file + "\".");
+      }
+#else
+      fd_ = ::open(lock_file.c_str(), O_RDWR | O_CREAT, 0666);
+      if (fd_ < 0 || ::flock(fd_, LOCK_EX) != 0) {
+        release_();
+        throw std::runtime_error("Failed to lock \"" + lock_file + "\".");
+      }
+#endif
+    }
+
+    Lock(const Lock &) = delete;
+    Lock &operator=(const Lock &) = delete;
+
+    Lock(Lock &&other) noexcept { *this = std::move(other); }
+    Lock &operator=(Lock &&other) noexcept {
+      release_();
+#if AUTOGEN_SYSTEM_WIN
+      std::swap(handle_, other.handle_);
+#else
+      std::swap(fd_, other.fd_);
+#endif
+      return *this;
+    }
+
+    ~Lock() { release_(); }
+
+   protected:
+    void release_() {
+      // the lock file is kept, removing it would allow two processes to lock
+      // different files of the same name
+#if AUTOGEN_SYSTEM_WIN
+      if (handle_ != INVALID_HANDLE_VALUE) {
+        OVERLAPPED overlapped{};
+        UnlockFileEx(handle_, 0, MAXDWORD, MAXDWORD, &overlapped);
+        CloseHandle(handle_);
+        handle_ = INVALID_HANDLE_VALUE;
+      }
+#else
+      if (fd_ >= 0) {
+        ::flock(fd_, LOCK_UN);
+        ::close(fd_);
+        fd_ = -1;
+      }
+#endif
+    }
+  };
+
+  /**
+   * Blocks until the calling process holds the lock of the entry `key`.
+   */
+  Lock lock(const std::string &key) const { return Lock(path(key, ".lock")); }
+
+ protected:
+  static long process_id_() {
+#if AUTOGEN_SYSTEM_WIN
+    return static_cast<long>(_getpid());
+#else
+    return static_cast<long>(::getpid());
+#endif
+  }
+};
+}  // namespace autogen
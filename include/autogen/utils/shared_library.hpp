@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace autogen {
+/**
+ * Shared library that is loaded at runtime and unloaded when the instance is
+ * destroyed. Depends only on the dynamic loader of the system, and provides
+ * the `loadFunction()` interface that `CpuBatchFunction` expects of a library.
+ */
+class SharedLibrary {
+  void *handle_{nullptr};
+  std::string filename_;
+
+ public:
+#if defined(_WIN32)
+  static const inline std::string extension = ".dll";
+#else
+  static const inline std::string extension = ".so";
+#endif
+
+  explicit SharedLibrary(const std::string &filename) : filename_(filename) {
+#if defined(_WIN32)
+    handle_ = static_cast<void *>(LoadLibraryA(filename.c_str()));
+    if (handle_ == nullptr) {
+      throw std::runtime_error("Failed to load the library \"" + filename +
+                               "\" (error code " +
+                               std::to_string(GetLastError()) + ").");
+    }
+#else
+    handle_ = dlopen(filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle_ == nullptr) {
+      const char *error = dlerror();
+      throw std::runtime_error("Failed to load the library \"" + filename +
+                               "\": " + (error ? error : "unknown error"));
+    }
+#endif
+  }
+
+  SharedLibrary(const SharedLibrary &) = delete;
+  SharedLibrary &operator=(const SharedLibrary &) = delete;
+
+  virtual ~SharedLibrary() {
+#if defined(_WIN32)
+    FreeLibrary(static_cast<HMODULE>(handle_));
+#else
+    dlclose(handle_);
+#endif
+    handle_ = nullptr;
+  }
+
+  const std::string &filename() const { return filename_; }
+
+  /**
+   * Address of the exported symbol `name`, or `nullptr` if the library does
+   * not contain it and `required` is false.
+   */
+  void *loadFunction(const std::string &name, bool required = true) const {
+#if defined(_WIN32)
+    void *fun = reinterpret_cast<void *>(
+        GetProcAddress(static_cast<HMODULE>(handle_), name.c_str()));
+#else
+    void *fun = dlsym(handle_, name.c_str());
+#endif
+    if (fun == nullptr && required) {
+      throw std::runtime_error("Function \"" + name +
+                               "\" was not found in the library \"" +
+                               filename_ + "\".");
+    }
+    return fun;
+  }
+};
+}  // namespace autogen
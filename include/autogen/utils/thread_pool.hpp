@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace autogen {
+/**
+ * Persistent pool of worker threads with one work-stealing deque per worker.
+ *
+ * Parallel loops are split into chunks that are distributed over the worker
+ * deques. Workers process their own deque from the back and steal from the
+ * front of the other deques when they run out of work. The calling thread
+ * participates in the loop until all of its chunks have been processed.
+ *
+ * A single pool can be shared between several functions (see `global()`), so
+ * that concurrent evaluations do not oversubscribe the available cores.
+ */
+class ThreadPool {
+ public:
+  using RangeFunction = std::function<void(int begin, int end)>;
+
+ protected:
+  struct Job {
+    const RangeFunction *fun;
+    std::atomic<int> remaining{0};
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr error{nullptr};
+  };
+
+  struct Task {
+    Job *job;
+    int begin;
+    int end;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> queues_;
+  std::vector<std::thread> threads_;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::atomic<int> num_queued_{0};
+  bool stop_{false};
+
+  // used to distribute the chunks of successive loops over the deques
+  std::atomic<unsigned int> next_queue_{0};
+
+  bool pin_threads_{false};
+
+  static inline thread_local const ThreadPool *current_pool_{nullptr};
+  static inline thread_local int current_worker_index_{-1};
+
+ public:
+  /**
+   * Creates a pool of `num_workers` threads, or one thread per hardware
+   * thread if `num_workers <= 0`. If `pin_threads` is true, worker `i` is
+   * pinned to logical core `i` (only supported on Linux and Windows).
+   */
+  explicit ThreadPool(int num_workers = 0, bool pin_threads = false)
+      : pin_threads_(pin_threads) {
+    if (num_workers <= 0) {
+      num_workers =
+          std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    for (int i = 0; i < num_workers; ++i) {
+      queues_.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < num_workers; ++i) {
+      threads_.emplace_back([this, i]() { run_worker_(i); });
+      if (pin_threads_) {
+        pin_thread_(threads_.back(), i);
+      }
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  virtual ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_) {
+      thread.join();
+    }
+  }
+
+  /**
+   * Default pool that is shared by all functions which have not been assigned
+   * a pool explicitly.
+   */
+  static std::shared_ptr<ThreadPool> global() {
+    static std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>();
+    return pool;
+  }
+
+  int num_workers() const { return static_cast<int>(threads_.size()); }
+  bool pin_threads() const { return pin_threads_; }
+
+  /**
+   * Index of the calling thread among the workers of this pool, or -1 if the
+   * calling thread is not a worker of this pool.
+   */
+  int worker_index() const {
+    return current_pool_ == this ? current_worker_index_ : -1;
+  }
+
+  /**
+   * Calls `fun(begin, end)` on consecutive chunks of at most `chunk_size`
+   * indices covering `[0, n)`, and blocks until all chunks have been
+   * processed. If `chunk_size <= 0`, the range is split into a few chunks per
+   * worker. Exceptions thrown by `fun` are rethrown in the calling thread.
+   *
+   * Loops that are started from a worker of this pool (e.g. a vectorized
+   * evaluation inside a parallel reduction) run serially on that worker, since
+   * the enclosing loop already occupies the pool.
+   */
+  void parallel_for(int n, int chunk_size, const RangeFunction &fun) {
+    if (n <= 0) {
+      return;
+    }
+    if (chunk_size <= 0) {
+      // a few chunks per worker leave room for load balancing
+      chunk_size = std::max(1, n / (4 * (num_workers() + 1)));
+    }
+    const int num_chunks = (n + chunk_size - 1) / chunk_size;
+    if (num_chunks == 1 || worker_index() >= 0) {
+      fun(0, n);
+      return;
+    }
+
+    Job job;
+    job.fun = &fun;
+    job.remaining = num_chunks;
+    const unsigned int first_queue = next_queue_.fetch_add(1);
+    for (int c = 0; c < num_chunks; ++c) {
+      Worker &worker = *queues_[(first_queue + c) % queues_.size()];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.tasks.push_back(
+          {&job, c * chunk_size, std::min(n, (c + 1) * chunk_size)});
+    }
+    num_queued_ += num_chunks;
+    {
+      // synchronize with workers that are about to wait
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    wake_.notify_all();
+
+    // help processing chunks until all chunks of this loop are done
+    Task task;
+    while (job.remaining.load() > 0) {
+      if (steal_(first_queue % queues_.size(), task)) {
+        execute_(task);
+      } else {
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.done.wait(lock, [&job]() { return job.remaining.load() == 0; });
+      }
+    }
+    // wait until the thread that finished the last chunk released the job
+    std::lock_guard<std::mutex> lock(job.mutex);
+    if (job.error) {
+      std::rethrow_exception(job.error);
+    }
+  }
+
+ protected:
+  void run_worker_(int index) {
+    current_pool_ = this;
+    current_worker_index_ = index;
+    Task task;
+    while (true) {
+      if (pop_(index, task) || steal_(index + 1, task)) {
+        execute_(task);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_.wait(lock, [this]() { return stop_ || num_queued_.load() > 0; });
+      if (stop_) {
+        return;
+      }
+    }
+  }
+
+  // takes the most recently added task from the worker's own deque
+  bool pop_(int index, Task &task) {
+    Worker &worker = *queues_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+      return false;
+    }
+    task = worker.tasks.back();
+    worker.tasks.pop_back();
+    --num_queued_;
+    return true;
+  }
+
+  // takes the oldest task from the first non-empty deque starting at `start`
+  bool steal_(std::size_t start, Task &task) {
+    const std::size_t num_queues = queues_.size();
+    for (std::size_t i = 0; i < num_queues; ++i) {
+      Worker &worker = *queues_[(start + i) % num_queues];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      if (worker.tasks.empty()) {
+        continue;
+      }
+      task = worker.tasks.front();
+      worker.tasks.pop_front();
+      --num_queued_;
+      return true;
+    }
+    return false;
+  }
+
+  static void execute_(const Task &task) {
+    Job &job = *task.job;
+    try {
+      (*job.fun)(task.begin, task.end);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(job.mutex);
+      if (!job.error) {
+        job.error = std::current_exception();
+      }
+    }
+    // the job lives on the stack of the calling thread, which may return as
+    // soon as the last chunk is done, so it must not be touched after the
+    // mutex has been released
+    std::lock_guard<std::mutex> lock(job.mutex);
+    if (--job.remaining == 0) {
+      job.done.notify_all();
+    }
+  }
+
+  static void pin_thread_(std::thread &thread, int index) {
+    const int num_cores =
+        std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+#if defined(__linux__)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(index % num_cores, &cpuset);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(thread.native_handle(),
+                          DWORD_PTR(1) << (index % num_cores));
+#else
+    (void)thread;
+    (void)index;
+    (void)num_cores;
+#endif
+  }
+};
+}  // namespace autogen
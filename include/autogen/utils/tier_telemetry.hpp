@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace autogen {
+/**
+ * Execution tier of a function in `GENERATE_AUTO` mode.
+ */
+enum ExecutionTier {
+  // evaluated on the CppAD tape
+  TIER_CPPAD,
+  // evaluated on the CppAD tape while the CPU code is compiled
+  TIER_COMPILING,
+  // evaluated via the compiled CPU code
+  TIER_COMPILED
+};
+
+static inline std::string str(const ExecutionTier& tier) {
+  switch (tier) {
+    case TIER_CPPAD:
+      return "CppAD";
+    case TIER_COMPILING:
+      return "Compiling";
+    case TIER_COMPILED:
+      return "Compiled";
+  }
+  return "Unknown";
+}
+
+/**
+ * Counters of a function in `GENERATE_AUTO` mode, which are updated by the
+ * function and read by `TierRegistry`.
+ */
+struct TierCounters {
+  const std::string name;
+  std::atomic<ExecutionTier> tier{TIER_CPPAD};
+  // evaluations on the CppAD tape
+  std::atomic<std::uint64_t> num_calls{0};
+  // accumulated time of the evaluations on the CppAD tape
+  std::atomic<std::uint64_t> evaluation_time_ns{0};
+
+  explicit TierCounters(const std::string& name) : name(name) {}
+};
+
+/**
+ * Snapshot of the `TierCounters` of a function.
+ */
+struct TierStatistics {
+  std::string name;
+  ExecutionTier tier;
+  std::uint64_t num_calls;
+  // in seconds
+  double evaluation_time;
+};
+
+/**
+ * Registry of the functions in `GENERATE_AUTO` mode, which reports the tier
+ * each function is in and how much time it has spent on the CppAD tape.
+ */
+class TierRegistry {
+  mutable std::mutex mutex_;
+  mutable std::vector<std::weak_ptr<TierCounters>> counters_;
+
+ public:
+  static TierRegistry& global() {
+    static TierRegistry registry;
+    return registry;
+  }
+
+  /**
+   * Creates the counters of a function, which are listed until they are
+   * destroyed.
+   */
+  std::shared_ptr<TierCounters> add(const std::string& name) {
+    auto counters = std::make_shared<TierCounters>(name);
+    std::lock_guard<std::mutex> guard(mutex_);
+    counters_.push_back(counters);
+    return counters;
+  }
+
+  std::vector<TierStatistics> statistics() const {
+    std::vector<TierStatistics> result;
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::vector<std::weak_ptr<TierCounters>> alive;
+    for (const auto& weak : counters_) {
+      if (auto counters = weak.lock()) {
+        result.push_back({counters->name, counters->tier.load(),
+                          counters->num_calls.load(),
+                          counters->evaluation_time_ns.load() * 1e-9});
+        alive.push_back(weak);
+      }
+    }
+    counters_.swap(alive);
+    return result;
+  }
+
+  void print(std::ostream& os) const {
+    os << std::left << std::setw(32) << "Function" << std::setw(12) << "Tier"
+       << std::right << std::setw(12) << "Calls" << std::setw(14)
+       << "CppAD time [s]" << "\n";
+    for (const auto& stats : statistics()) {
+      os << std::left << std::setw(32) << stats.name << std::setw(12)
+         << str(stats.tier) << std::right << std::setw(12) << stats.num_calls
+         << std::setw(14) << stats.evaluation_time << "\n";
+    }
+  }
+};
+}  // namespace autogen
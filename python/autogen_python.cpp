@@ -87,6 +87,31 @@ void expose_max(py::module& m, const std::string& name) {
       py::arg("x"), py::arg("y"));
 }
 
+// Hessians of the weighted outputs for a batch of local inputs
+template <typename Generator>
+std::vector<std::vector<BaseScalar>> batch_hessian(
+    Generator& gen, const std::vector<std::vector<BaseScalar>>& local_inputs,
+    const std::vector<BaseScalar>& weights,
+    const std::vector<BaseScalar>& global_input) {
+  const int num_samples = static_cast<int>(local_inputs.size());
+  const int ld = gen.local_input_dim();
+  const int hd = gen.input_dim() * gen.input_dim();
+  std::vector<BaseScalar> local_flat;
+  for (const auto& local_input : local_inputs) {
+    local_flat.insert(local_flat.end(), local_input.begin(), local_input.end());
+  }
+  std::vector<BaseScalar> output_flat(num_samples * hd);
+  gen.hessian(num_samples, {local_flat.data(), ld}, {weights.data(), 0},
+              {output_flat.data(), hd},
+              {global_input.empty() ? nullptr : global_input.data(), 0});
+  std::vector<std::vector<BaseScalar>> outputs(num_samples);
+  for (int i = 0; i < num_samples; ++i) {
+    outputs[i].assign(output_flat.begin() + i * hd,
+                      output_flat.begin() + (i + 1) * hd);
+  }
+  return outputs;
+}
+
 PYBIND11_MODULE(_autogen, m) {
   m.doc() = R"pbdoc(
         Autogen python plugin
@@ -262,6 +287,40 @@ PYBIND11_MODULE(_autogen, m) {
             return outputs;
           },
           "Evaluates the Jacobian of the function")
+      .def(
+          "jvp",
+          [](autogen::GeneratedCppAD& gen, const std::vector<BaseScalar>& input,
+             const std::vector<BaseScalar>& tangent) {
+            std::vector<BaseScalar> output;
+            gen.jvp(input, tangent, output);
+            return output;
+          },
+          "Evaluates the Jacobian-vector product J(input) * tangent",
+          py::arg("input"), py::arg("tangent"))
+      .def(
+          "vjp",
+          [](autogen::GeneratedCppAD& gen, const std::vector<BaseScalar>& input,
+             const std::vector<BaseScalar>& cotangent) {
+            std::vector<BaseScalar> output;
+            gen.vjp(input, cotangent, output);
+            return output;
+          },
+          "Evaluates the vector-Jacobian product cotangent^T * J(input)",
+          py::arg("input"), py::arg("cotangent"))
+      .def(
+          "hessian",
+          [](autogen::GeneratedCppAD& gen, const std::vector<BaseScalar>& input,
+             const std::vector<BaseScalar>& weights) {
+            std::vector<BaseScalar> output;
+            gen.hessian(input, weights, output);
+            return output;
+          },
+          "Evaluates the Hessian of the outputs weighted by the given weights",
+          py::arg("input"), py::arg("weights"))
+      .def("hessian", &batch_hessian<autogen::GeneratedCppAD>,
+           "Evaluates the Hessian of the weighted outputs for each local input",
+           py::arg("local_inputs"), py::arg("weights"),
+           py::arg("global_input"))
       .def_property_readonly("input_dim", &autogen::GeneratedCppAD::input_dim)
       .def_property_readonly("local_input_dim",
                              &autogen::GeneratedCppAD::local_input_dim)
@@ -270,6 +329,17 @@ PYBIND11_MODULE(_autogen, m) {
                     &autogen::GeneratedCppAD::global_input_dim,
                     &autogen::GeneratedCppAD::set_global_input_dim);
 
+  py::class_<autogen::TapeOptimizationOptions>(m, "TapeOptimizationOptions")
+      .def(py::init<>())
+      .def_readwrite("fold_constants",
+                     &autogen::TapeOptimizationOptions::fold_constants)
+      .def_readwrite("eliminate_dead_outputs",
+                     &autogen::TapeOptimizationOptions::eliminate_dead_outputs)
+      .def_readwrite("cppad_optimize",
+                     &autogen::TapeOptimizationOptions::cppad_optimize)
+      .def_readwrite("cppad_optimize_options",
+                     &autogen::TapeOptimizationOptions::cppad_optimize_options);
+
   py::class_<autogen::GeneratedCodeGen,
              std::shared_ptr<autogen::GeneratedCodeGen>>(m, "GeneratedCodeGen")
       .def(py::init<const std::string&, std::shared_ptr<ADCGFun>>())
@@ -361,6 +431,96 @@ PYBIND11_MODULE(_autogen, m) {
             return outputs;
           },
           "Evaluates the Jacobian of the function")
+      .def(
+          "value_and_jacobian",
+          [](autogen::GeneratedCodeGen& gen,
+             const std::vector<BaseScalar>& input) {
+            std::vector<BaseScalar> output, jac;
+            if (input.size() != gen.input_dim()) {
+              throw std::runtime_error(
+                  "Input vector to function " + gen.library_name() +
+                  " has to be of dimension " + std::to_string(gen.input_dim()) +
+                  ". Provided was a vector of dimension " +
+                  std::to_string(input.size()) + ".");
+            }
+            gen.value_and_jacobian(input, output, jac);
+            return std::make_pair(output, jac);
+          },
+          "Evaluates the outputs and the Jacobian of the function in one "
+          "pass")
+      .def(
+          "jvp",
+          [](autogen::GeneratedCodeGen& gen,
+             const std::vector<BaseScalar>& input,
+             const std::vector<BaseScalar>& tangent) {
+            std::vector<BaseScalar> output;
+            gen.jvp(input, tangent, output);
+            return output;
+          },
+          "Evaluates the Jacobian-vector product J(input) * tangent",
+          py::arg("input"), py::arg("tangent"))
+      .def(
+          "vjp",
+          [](autogen::GeneratedCodeGen& gen,
+             const std::vector<BaseScalar>& input,
+             const std::vector<BaseScalar>& cotangent) {
+            std::vector<BaseScalar> output;
+            gen.vjp(input, cotangent, output);
+            return output;
+          },
+          "Evaluates the vector-Jacobian product cotangent^T * J(input)",
+          py::arg("input"), py::arg("cotangent"))
+      .def(
+          "hessian",
+          [](autogen::GeneratedCodeGen& gen,
+             const std::vector<BaseScalar>& input,
+             const std::vector<BaseScalar>& weights) {
+            std::vector<BaseScalar> output;
+            gen.hessian(input, weights, output);
+            return output;
+          },
+          "Evaluates the Hessian of the outputs weighted by the given weights",
+          py::arg("input"), py::arg("weights"))
+      .def("hessian", &batch_hessian<autogen::GeneratedCodeGen>,
+           "Evaluates the Hessian of the weighted outputs for each local input",
+           py::arg("local_inputs"), py::arg("weights"),
+           py::arg("global_input"))
+      .def(
+          "sparse_hessian",
+          [](const autogen::GeneratedCodeGen& gen,
+             const std::vector<BaseScalar>& input,
+             const std::vector<BaseScalar>& weights) {
+            std::vector<BaseScalar> values;
+            gen.sparse_hessian(input, weights, values);
+            return values;
+          },
+          "Evaluates the nonzero entries of the weighted Hessian in the CSR "
+          "order of hessian_sparsity",
+          py::arg("input"), py::arg("weights"))
+      .def_property_readonly(
+          "hessian_sparsity",
+          [](const autogen::GeneratedCodeGen& gen) {
+            const auto& pattern = gen.hessian_sparsity();
+            return std::make_pair(pattern.row_offsets, pattern.col_indices);
+          },
+          "CSR row offsets and column indices of the weighted Hessian")
+      .def(
+          "sparse_jacobian",
+          [](const autogen::GeneratedCodeGen& gen,
+             const std::vector<BaseScalar>& input) {
+            std::vector<BaseScalar> values;
+            gen.sparse_jacobian(input, values);
+            return values;
+          },
+          "Evaluates the nonzero entries of the Jacobian in the CSR order of "
+          "jacobian_sparsity")
+      .def_property_readonly(
+          "jacobian_sparsity",
+          [](const autogen::GeneratedCodeGen& gen) {
+            const auto& pattern = gen.jacobian_sparsity();
+            return std::make_pair(pattern.row_offsets, pattern.col_indices);
+          },
+          "CSR row offsets and column indices of the Jacobian")
       .def("compile_cpu", &autogen::GeneratedCodeGen::compile_cpu,
            "Compile to a CPU-bound shared library",
            py::call_guard<py::scoped_ostream_redirect,
@@ -369,13 +529,42 @@ PYBIND11_MODULE(_autogen, m) {
            "Compile to a GPU-bound shared library",
            py::call_guard<py::scoped_ostream_redirect,
                           py::scoped_estream_redirect>())
+      .def("compile_jit", &autogen::GeneratedCodeGen::compile_jit,
+           "Compile to an in-memory CPU library via the LLVM JIT",
+           py::call_guard<py::scoped_ostream_redirect,
+                          py::scoped_estream_redirect>())
+      .def("export_cpu", &autogen::GeneratedCodeGen::export_cpu,
+           "Export a C source bundle with header and CMakeLists.txt",
+           py::arg("directory"), py::arg("build_static_library") = false,
+           py::call_guard<py::scoped_ostream_redirect,
+                          py::scoped_estream_redirect>())
       .def_readwrite("optimization_level",
                      &autogen::GeneratedCodeGen::optimization_level)
       .def_readwrite("generate_forward",
                      &autogen::GeneratedCodeGen::generate_forward)
       .def_readwrite("generate_jacobian",
                      &autogen::GeneratedCodeGen::generate_jacobian)
+      .def_readwrite("generate_value_and_jacobian",
+                     &autogen::GeneratedCodeGen::generate_value_and_jacobian)
+      .def_readwrite("generate_sparse_jacobian",
+                     &autogen::GeneratedCodeGen::generate_sparse_jacobian)
+      .def_readwrite("generate_hessian",
+                     &autogen::GeneratedCodeGen::generate_hessian)
+      .def_readwrite(
+          "generate_directional_derivatives",
+          &autogen::GeneratedCodeGen::generate_directional_derivatives)
       .def_readwrite("debug_mode", &autogen::GeneratedCodeGen::debug_mode)
+      .def_readwrite("optimize_tapes",
+                     &autogen::GeneratedCodeGen::optimize_tapes)
+      .def_readwrite("tape_optimization",
+                     &autogen::GeneratedCodeGen::tape_optimization)
+      .def("optimize_traced_tapes",
+           &autogen::GeneratedCodeGen::optimize_traced_tapes,
+           "Run the tape optimization pipeline if it has not run yet",
+           py::call_guard<py::scoped_ostream_redirect,
+                          py::scoped_estream_redirect>())
+      .def_readwrite("cache_directory",
+                     &autogen::GeneratedCodeGen::cache_directory)
       .def_property_readonly("local_input_dim",
                              &autogen::GeneratedCodeGen::local_input_dim)
       .def_property_readonly("output_dim",
@@ -33,4 +33,22 @@ x = [2.0, 3.0]
 y = gen.forward(x)
 print("y = ", y)
 J = gen.jacobian(x)
-print("j = ", J)
\ No newline at end of file
+print("j = ", J)
+
+y, J = gen.value_and_jacobian(x)
+print("y = ", y)
+print("j = ", J)
+
+f = ag.trace(test_function, [1., 2.], ag.Mode.CPU)
+gen = ag.GeneratedCodeGen("test_function_hessian", f)
+gen.generate_hessian = True
+gen.compile_cpu()
+H = gen.hessian(x, [1.0])
+print("H = ", H)
+print("H sparsity = ", gen.hessian_sparsity)
+
+gen = ag.GeneratedCodeGen("test_function_products", f)
+gen.generate_directional_derivatives = True
+gen.compile_cpu()
+print("jvp = ", gen.jvp(x, [1.0, 0.0]))
+print("vjp = ", gen.vjp(x, [1.0]))